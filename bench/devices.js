@@ -0,0 +1,92 @@
+// Virtual devices for the benchmarks, each providing:
+//   path - to open the device with
+//   push(report) - send an input report from the device
+//   close() - remove the device
+const fs = require("fs");
+const UhidDevice = require("./uhid");
+
+const VENDOR_ID = 0x1209;
+const PRODUCT_ID = 0x0001;
+const REPORT_SIZE = 64;
+
+// Vendor defined, with unnumbered 64 byte input, output and feature reports
+const REPORT_DESCRIPTOR = [
+    0x06, 0x00, 0xff, // Usage Page (Vendor Defined)
+    0x09, 0x01, // Usage (1)
+    0xa1, 0x01, // Collection (Application)
+    0x15, 0x00, //   Logical Minimum (0)
+    0x26, 0xff, 0x00, //   Logical Maximum (255)
+    0x75, 0x08, //   Report Size (8)
+    0x95, REPORT_SIZE, //   Report Count
+    0x09, 0x01, //   Usage (1)
+    0x81, 0x02, //   Input (Data,Var,Abs)
+    0x95, REPORT_SIZE, //   Report Count
+    0x09, 0x01, //   Usage (1)
+    0x91, 0x02, //   Output (Data,Var,Abs)
+    0x95, REPORT_SIZE, //   Report Count
+    0x09, 0x01, //   Usage (1)
+    0xb1, 0x02, //   Feature (Data,Var,Abs)
+    0xc0, // End Collection
+];
+
+const backends = {
+    // The in-memory hidapi, built with `node-gyp rebuild --driver=mock`
+    mock: {
+        driverType: "mock",
+        check(HID) {
+            HID.getMockControl();
+        },
+        async create(HID, options) {
+            const mock = HID.getMockControl();
+            const path = mock.addDevice({
+                vendorId: VENDOR_ID,
+                productId: PRODUCT_ID,
+                serialNumber: options.serial,
+                reportDescriptor: REPORT_DESCRIPTOR,
+                inputReportSize: REPORT_SIZE,
+                reportsPerSecond: options.generate ? Infinity : 0,
+                maxQueuedReports: 64,
+            });
+            return {
+                path,
+                push: (report) => mock.pushInputReport(path, report),
+                close: () => mock.removeDevice(path),
+            };
+        },
+    },
+
+    // A Linux uhid device, read through the hidraw build. Needs write access to /dev/uhid
+    uhid: {
+        driverType: "hidraw",
+        check() {
+            if (process.platform !== "linux") throw new Error("uhid is only available on linux");
+            fs.closeSync(fs.openSync("/dev/uhid", "r+"));
+        },
+        async create(HID, options) {
+            const uhid = new UhidDevice({
+                vendorId: VENDOR_ID,
+                productId: PRODUCT_ID,
+                uniq: options.serial,
+                reportDescriptor: REPORT_DESCRIPTOR,
+            });
+
+            // Wait for the hidraw node to appear
+            for (let i = 0; i < 200; i++) {
+                const found = HID.devices(VENDOR_ID, PRODUCT_ID).find((d) => d.serialNumber === options.serial);
+                if (found) {
+                    return {
+                        path: found.path,
+                        push: (report) => uhid.input(report),
+                        close: () => uhid.close(),
+                    };
+                }
+                await new Promise((resolve) => setTimeout(resolve, 10));
+            }
+
+            uhid.close();
+            throw new Error("uhid device did not appear");
+        },
+    },
+};
+
+module.exports = { backends, REPORT_SIZE };
@@ -0,0 +1,150 @@
+#!/usr/bin/env node
+// Benchmarks for the native read, write, enumerate and open paths, against virtual devices.
+//
+//   npm run bench -- [--backend=mock,uhid] [--scenario=HIDAsync.read,...] [--duration=2000] [--out=results.json]
+//
+// Each backend is run in its own process, as the driver type can only be chosen once.
+// The results are written as JSON, to stdout or the --out file
+const child_process = require("child_process");
+const fs = require("fs");
+const os = require("os");
+
+const { backends } = require("./devices");
+const scenarios = require("./scenarios");
+
+function parseArgs(argv) {
+    const args = {
+        backend: Object.keys(backends),
+        scenario: Object.keys(scenarios),
+        duration: 2000,
+        out: null,
+        child: false,
+    };
+    for (const arg of argv) {
+        const [key, value] = arg.replace(/^--/, "").split("=");
+        if (key === "backend" || key === "scenario") args[key] = value.split(",");
+        else if (key === "duration") args.duration = Number(value);
+        else if (key === "out") args.out = value;
+        else if (key === "child") args.child = true;
+        else throw new Error(`Unknown argument: ${arg}`);
+    }
+    return args;
+}
+
+function percentile(sorted, p) {
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+function summarize(backend, name, result, elapsedNs, cpu) {
+    const summary = {
+        backend,
+        scenario: name,
+        count: result.count,
+        durationMs: elapsedNs / 1e6,
+        opsPerSec: result.count / (elapsedNs / 1e9),
+        latencyUs: null,
+        cpuUsPerOp: result.count ? (cpu.user + cpu.system) / result.count : null,
+    };
+    if (result.latencies && result.latencies.length) {
+        const sorted = Float64Array.from(result.latencies).sort();
+        summary.latencyUs = {
+            p50: percentile(sorted, 0.5) / 1e3,
+            p90: percentile(sorted, 0.9) / 1e3,
+            p99: percentile(sorted, 0.99) / 1e3,
+            max: sorted[sorted.length - 1] / 1e3,
+        };
+    }
+    return summary;
+}
+
+async function runBackend(args) {
+    const name = args.backend[0];
+    const backend = backends[name];
+    if (!backend) throw new Error(`Unknown backend: ${name}`);
+
+    const HID = require("..");
+    HID.setDriverType(backend.driverType);
+
+    try {
+        backend.check(HID);
+    } catch (e) {
+        return [{ backend: name, skipped: e.message }];
+    }
+
+    const results = [];
+    for (const scenario of args.scenario) {
+        const run = scenarios[scenario];
+        if (!run) throw new Error(`Unknown scenario: ${scenario}`);
+
+        const generate = scenario.endsWith("-generated");
+        if (generate && name !== "mock") {
+            results.push({ backend: name, scenario, skipped: "only supported by the mock backend" });
+            continue;
+        }
+
+        const device = await backend.create(HID, { serial: `bench-${process.pid}-${results.length}`, generate });
+        try {
+            const cpuStart = process.cpuUsage();
+            const start = process.hrtime.bigint();
+            const result = await run({ HID, device, duration: args.duration });
+            const elapsed = Number(process.hrtime.bigint() - start);
+            results.push(summarize(name, scenario, result, elapsed, process.cpuUsage(cpuStart)));
+        } catch (e) {
+            results.push({ backend: name, scenario, error: e.message });
+        } finally {
+            device.close();
+        }
+    }
+    return results;
+}
+
+async function main() {
+    const args = parseArgs(process.argv.slice(2));
+
+    if (args.child) {
+        const results = await runBackend(args);
+        process.stdout.write(JSON.stringify(results));
+        // Any uhid devices have reads pending on the threadpool, which would otherwise keep the process alive
+        process.exit(0);
+    }
+
+    const HID = require("..");
+    const output = {
+        date: new Date().toISOString(),
+        node: process.version,
+        platform: `${process.platform}-${process.arch}`,
+        cpu: os.cpus()[0] && os.cpus()[0].model,
+        version: require("../package.json").version,
+        hidapiVersion: null,
+        durationMs: args.duration,
+        results: [],
+    };
+
+    for (const backend of args.backend) {
+        const child = child_process.spawnSync(
+            process.execPath,
+            [__filename, "--child", `--backend=${backend}`, `--scenario=${args.scenario.join(",")}`, `--duration=${args.duration}`],
+            { encoding: "utf8", stdio: ["ignore", "pipe", "inherit"] }
+        );
+        try {
+            output.results.push(...JSON.parse(child.stdout));
+        } catch (e) {
+            output.results.push({ backend, error: `benchmark process failed with status ${child.status}` });
+        }
+    }
+
+    try {
+        output.hidapiVersion = HID.getHidapiVersion();
+    } catch (e) {
+        // The binding may not be built
+    }
+
+    const json = JSON.stringify(output, null, 2);
+    if (args.out) fs.writeFileSync(args.out, json + "\n");
+    else console.log(json);
+}
+
+main().catch((e) => {
+    console.error(e);
+    process.exit(1);
+});
@@ -0,0 +1,174 @@
+// Each scenario runs against a virtual device until `duration` ms have passed,
+// returning the number of operations and the latency of each in nanoseconds
+const { REPORT_SIZE } = require("./devices");
+
+// How many input reports may be in flight, kept below the 64 queued by hidraw and the mock
+const READ_WINDOW = 32;
+
+function now() {
+    return process.hrtime.bigint();
+}
+
+function deadline(duration) {
+    return now() + BigInt(Math.round(duration * 1e6));
+}
+
+function makeReport(seq) {
+    const report = Buffer.alloc(REPORT_SIZE);
+    report.writeUInt32LE(seq, 0);
+    return report;
+}
+
+// Time a single async operation repeatedly
+async function repeat(duration, fn) {
+    const end = deadline(duration);
+    const latencies = [];
+    let count = 0;
+    while (now() < end) {
+        const start = now();
+        await fn(count);
+        latencies.push(Number(now() - start));
+        count++;
+    }
+    return { count, latencies };
+}
+
+const scenarios = {
+    // Streaming input reports through device.on('data'), from the device pushing a report until it is emitted
+    "HIDAsync.readStart": async ({ HID, device, duration }) => {
+        const hid = await HID.HIDAsync.open(device.path);
+        const sent = new Map();
+        const latencies = [];
+        let seq = 0;
+        let received = 0;
+        const end = deadline(duration);
+
+        await new Promise((resolve) => {
+            let lastReceived = -1;
+            const watchdog = setInterval(() => {
+                // Give up on anything which was lost
+                if (received === lastReceived) finish();
+                lastReceived = received;
+            }, 1000);
+
+            const finish = () => {
+                clearInterval(watchdog);
+                resolve();
+            };
+
+            const fill = () => {
+                while (seq - received < READ_WINDOW && now() < end) {
+                    sent.set(seq, now());
+                    device.push(makeReport(seq));
+                    seq++;
+                }
+            };
+
+            hid.on("data", (data) => {
+                const time = sent.get(data.readUInt32LE(0));
+                if (time !== undefined) {
+                    latencies.push(Number(now() - time));
+                    sent.delete(data.readUInt32LE(0));
+                }
+                received++;
+
+                if (now() < end) fill();
+                else if (received >= seq) finish();
+            });
+            fill();
+        });
+
+        await hid.close();
+        return { count: received, latencies };
+    },
+
+    // Raw throughput of device.on('data'), with the device producing reports as fast as they are read
+    "HIDAsync.readStart-generated": async ({ HID, device, duration }) => {
+        const hid = await HID.HIDAsync.open(device.path);
+        let count = 0;
+        hid.on("data", () => {
+            count++;
+        });
+        await new Promise((resolve) => setTimeout(resolve, duration));
+        await hid.close();
+        return { count, latencies: null };
+    },
+
+    "HIDAsync.readStart-decoded-generated": async ({ HID, device, duration }) => {
+        const hid = await HID.HIDAsync.open(device.path);
+        let count = 0;
+        let sum = 0;
+        hid.on("values", (values) => {
+            count++;
+            sum += values[0];
+        });
+        await new Promise((resolve) => setTimeout(resolve, duration));
+        await hid.close();
+        return { count, latencies: null };
+    },
+
+    "HIDAsync.read": async ({ HID, device, duration }) => {
+        const hid = await HID.HIDAsync.open(device.path);
+        const result = await repeat(duration, async (i) => {
+            device.push(makeReport(i));
+            await hid.read(1000);
+        });
+        await hid.close();
+        return result;
+    },
+
+    "HID.read": async ({ HID, device, duration }) => {
+        const hid = new HID.HID(device.path);
+        const result = await repeat(duration, (i) => {
+            device.push(makeReport(i));
+            return new Promise((resolve, reject) => hid.read((err, data) => (err ? reject(err) : resolve(data))));
+        });
+        hid.close();
+        return result;
+    },
+
+    "HID.readTimeout": async ({ HID, device, duration }) => {
+        const hid = new HID.HID(device.path);
+        const result = await repeat(duration, async (i) => {
+            device.push(makeReport(i));
+            hid.readTimeout(1000);
+        });
+        hid.close();
+        return result;
+    },
+
+    "HIDAsync.write": async ({ HID, device, duration }) => {
+        const hid = await HID.HIDAsync.open(device.path);
+        const report = Buffer.alloc(REPORT_SIZE + 1);
+        const result = await repeat(duration, () => hid.write(report));
+        await hid.close();
+        return result;
+    },
+
+    "HIDAsync.getFeatureReport": async ({ HID, device, duration }) => {
+        const hid = await HID.HIDAsync.open(device.path);
+        await hid.sendFeatureReport(Buffer.alloc(REPORT_SIZE + 1));
+        const result = await repeat(duration, () => hid.getFeatureReport(0, REPORT_SIZE + 1));
+        await hid.close();
+        return result;
+    },
+
+    devicesAsync: async ({ HID, duration }) => {
+        return repeat(duration, () => HID.devicesAsync());
+    },
+
+    // Only the open is timed, the close is still included in the cpu time
+    openAsyncHIDDevice: async ({ HID, device, duration }) => {
+        const end = deadline(duration);
+        const latencies = [];
+        while (now() < end) {
+            const start = now();
+            const hid = await HID.HIDAsync.open(device.path);
+            latencies.push(Number(now() - start));
+            await hid.close();
+        }
+        return { count: latencies.length, latencies };
+    },
+};
+
+module.exports = scenarios;
@@ -0,0 +1,113 @@
+// A minimal Linux uhid device, written directly to /dev/uhid.
+// See https://www.kernel.org/doc/html/latest/hid/uhid.html for the protocol
+const EventEmitter = require("events").EventEmitter;
+const fs = require("fs");
+
+// sizeof(struct uhid_event)
+const UHID_EVENT_SIZE = 4376;
+
+const UHID_DESTROY = 1;
+const UHID_OUTPUT = 6;
+const UHID_GET_REPORT = 9;
+const UHID_GET_REPORT_REPLY = 10;
+const UHID_CREATE2 = 11;
+const UHID_INPUT2 = 12;
+const UHID_SET_REPORT = 13;
+const UHID_SET_REPORT_REPLY = 14;
+
+const BUS_USB = 3;
+
+class UhidDevice extends EventEmitter {
+    constructor(options) {
+        super();
+
+        this._fd = fs.openSync("/dev/uhid", "r+");
+        this._event = Buffer.alloc(UHID_EVENT_SIZE);
+        this._features = new Map();
+        this._closed = false;
+
+        const ev = this._clear(UHID_CREATE2);
+        ev.write(options.name || "node-hid uhid", 4, 127);
+        ev.write(options.uniq || "", 196, 63);
+        ev.writeUInt16LE(options.reportDescriptor.length, 260);
+        ev.writeUInt16LE(BUS_USB, 262);
+        ev.writeUInt32LE(options.vendorId, 264);
+        ev.writeUInt32LE(options.productId, 268);
+        Buffer.from(options.reportDescriptor).copy(ev, 280);
+        fs.writeSync(this._fd, ev);
+
+        this._readLoop();
+    }
+
+    _clear(type) {
+        this._event.fill(0);
+        this._event.writeUInt32LE(type, 0);
+        return this._event;
+    }
+
+    // Send an input report to the host
+    input(data) {
+        const ev = this._clear(UHID_INPUT2);
+        ev.writeUInt16LE(data.length, 4);
+        data.copy(ev, 6);
+        fs.writeSync(this._fd, ev, 0, 6 + data.length);
+    }
+
+    _readLoop() {
+        const buf = Buffer.alloc(UHID_EVENT_SIZE);
+        const next = () => {
+            fs.read(this._fd, buf, 0, UHID_EVENT_SIZE, null, (err, n) => {
+                if (this._closed) return;
+                if (err) {
+                    this.emit("error", err);
+                    return;
+                }
+                if (n >= 4) this._handle(buf);
+                next();
+            });
+        };
+        next();
+    }
+
+    _handle(buf) {
+        switch (buf.readUInt32LE(0)) {
+            case UHID_OUTPUT: {
+                const size = buf.readUInt16LE(4100);
+                this.emit("output", Buffer.from(buf.subarray(4, 4 + size)));
+                break;
+            }
+            case UHID_GET_REPORT: {
+                const id = buf.readUInt32LE(4);
+                const data = this._features.get(buf.readUInt8(8));
+                const ev = this._clear(UHID_GET_REPORT_REPLY);
+                ev.writeUInt32LE(id, 4);
+                if (data) {
+                    ev.writeUInt16LE(data.length, 10);
+                    data.copy(ev, 12);
+                } else {
+                    ev.writeUInt16LE(5, 8); // EIO
+                }
+                fs.writeSync(this._fd, ev);
+                break;
+            }
+            case UHID_SET_REPORT: {
+                const id = buf.readUInt32LE(4);
+                const size = buf.readUInt16LE(10);
+                this._features.set(buf.readUInt8(8), Buffer.from(buf.subarray(12, 12 + size)));
+                const ev = this._clear(UHID_SET_REPORT_REPLY);
+                ev.writeUInt32LE(id, 4);
+                fs.writeSync(this._fd, ev);
+                break;
+            }
+        }
+    }
+
+    close() {
+        if (this._closed) return;
+        this._closed = true;
+        fs.writeSync(this._fd, this._clear(UHID_DESTROY));
+        fs.closeSync(this._fd);
+    }
+}
+
+module.exports = UhidDevice;
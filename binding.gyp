@@ -10,8 +10,14 @@
                 'src/exports.cc',
                 'src/HID.cc',
                 'src/HIDAsync.cc',
+                'src/descriptor.cc',
                 'src/devices.cc',
+                'src/enumeration.cc',
+                'src/filter.cc',
+                'src/framer.cc',
                 'src/read.cc',
+                'src/scheduler.cc',
+                'src/stats.cc',
                 'src/util.cc'
             ],
             'dependencies': ['hidapi'],
@@ -20,6 +26,10 @@
                 '_FILE_OFFSET_BITS=64',
             ],
             'conditions': [
+                [ 'driver=="mock"', {
+                    'sources': ['src/mock.cc'],
+                    'defines': ['NODE_HID_MOCK']
+                }], # driver==mock
                 [ 'OS=="mac"', {
                     'LDFLAGS': [
                         '-framework IOKit',
@@ -43,7 +53,9 @@
                             'libraries': ['-lusb-1.0']
                         }],
                         [ 'driver=="hidraw"', {
-                            'libraries': ['-ludev','-lusb-1.0']
+                            'sources': ['src/hotplug.cc', 'src/reactor.cc'],
+                            'libraries': ['-ludev','-lusb-1.0'],
+                            'defines': ['NODE_HID_HIDRAW']
                         }]
                     ],
                 }], # OS==linux
@@ -72,6 +84,16 @@
             'target_name': 'hidapi',
             'type': 'static_library',
             'conditions': [
+                [ 'driver=="mock"', {
+                    # An in-memory backend in place of the platform one, for testing and benchmarking
+                    'sources': [ 'src/hidapi-mock/hid.cc' ],
+                    'sources!': [ 'hidapi/mac/hid.c', 'hidapi/libusb/hid.c', 'hidapi/windows/hid.c' ],
+                    'cflags_cc!': [ '-fno-exceptions' ],
+                    'xcode_settings': {
+                        'CLANG_CXX_LIBRARY': 'libc++',
+                        'MACOSX_DEPLOYMENT_TARGET': '10.9',
+                    }
+                }], # driver==mock
                 [ 'OS=="mac"', {
                     'sources': [ 'hidapi/mac/hid.c' ],
                     'include_dirs+': ['/usr/include/libusb-1.0/'],
@@ -136,14 +158,23 @@
                         'src/exports.cc',
                         'src/HID.cc',
                         'src/HIDAsync.cc',
+                        'src/descriptor.cc',
                         'src/devices.cc',
+                        'src/enumeration.cc',
+                        'src/filter.cc',
+                        'src/framer.cc',
+                        'src/hotplug.cc',
+                        'src/reactor.cc',
                         'src/read.cc',
+                        'src/scheduler.cc',
+                        'src/stats.cc',
                         'src/util.cc'
                     ],
                     'dependencies': ['hidapi-linux-hidraw'],
                     'defines': [
                         '_LARGEFILE_SOURCE',
                         '_FILE_OFFSET_BITS=64',
+                        'NODE_HID_HIDRAW',
                     ],
                     'libraries': [
                         '-ludev',
@@ -25,15 +25,23 @@ export class HID extends EventEmitter {
     constructor(vid: number, pid: number, options?: { nonExclusive?: boolean })
     close(): void
     pause(): void
-    read(callback: (err: any, data: number[]) => void): void
+    read(callback: (err: any, data: number[], receivedAt: number, sequence: number) => void): void
     readSync(): number[]
     readTimeout(time_out: number): number[]
+    readSyncInto(buffer: Uint8Array): number
+    readTimeoutInto(buffer: Uint8Array, time_out: number): number
     sendFeatureReport(data: number[] | Buffer): number
     getFeatureReport(report_id: number, report_length: number): number[]
+    getFeatureReportInto(report_id: number, buffer: Uint8Array): number
     resume(): void
     write(values: number[] | Buffer): number
+    writeMany(reports: Array<number[] | Buffer>): number[]
+    writeMany(data: Buffer, stride: number): number[]
     setNonBlocking(no_block: boolean): void
     getDeviceInfo(): Device
+    getReportDescriptor(): Buffer
+    getReportFields(): ReportField[]
+    getStats(): DeviceStats
 }
 
 export function devices(vid: number, pid: number): Device[]
@@ -42,6 +50,89 @@ export function devices(): Device[]
 export function devicesAsync(vid: number, pid: number): Promise<Device[]>
 export function devicesAsync(): Promise<Device[]>
 
+export interface LatencyHistogram {
+    count: number
+    meanUs: number
+    p50Us: number
+    p90Us: number
+    p99Us: number
+    maxUs: number
+    buckets: number[]
+}
+
+export interface DeviceStats {
+    reportsRead: number
+    bytesRead: number
+    readErrors: number
+    reportsDropped: number
+    reportsFiltered: number
+    reportsUnchanged: number
+    reportsDecimated: number
+    messagesRead: number
+    framingErrors: number
+    reportsWritten: number
+    bytesWritten: number
+    writeErrors: number
+    writesCoalesced: number
+    scheduleOverruns: number
+    featureReports: number
+    featureErrors: number
+    featureReportsUnchanged: number
+    callbackQueueDepth: number
+    callbackQueueHighWater: number
+    queueWait: LatencyHistogram
+    writeDuration: LatencyHistogram
+    featureDuration: LatencyHistogram
+    callbackLag: LatencyHistogram
+}
+
+export interface GlobalStats extends DeviceStats {
+    openDevices: number
+}
+
+export interface ReadOptions {
+    batchSize?: number | undefined
+    batchTimeout?: number | undefined
+    maxQueue?: number | undefined
+    overflow?: 'block' | 'drop-oldest' | 'drop-newest' | 'coalesce' | undefined
+    decode?: boolean | undefined
+    reportIds?: number[] | null | undefined
+    changesOnly?: boolean | undefined
+    changeMask?: number[] | Buffer | undefined
+    maxRate?: number | undefined
+}
+
+export interface FramerConfig {
+    reportSize?: number | undefined
+    reportId?: number | undefined
+    channel?: number[] | Buffer | undefined
+    lengthSize?: number | undefined
+    littleEndian?: boolean | undefined
+}
+
+export interface TransactOptions {
+    match?: { offset?: number | undefined, length?: number | undefined, bytes?: number[] | Buffer | undefined } | undefined
+    timeout?: number | undefined
+}
+
+export interface ReportField {
+    type: 'input' | 'output' | 'feature'
+    reportId: number
+    usagePage: number
+    usage: number
+    bitOffset: number
+    bitSize: number
+    logicalMinimum: number
+    logicalMaximum: number
+    physicalMinimum: number
+    physicalMaximum: number
+    unitExponent: number
+    unit: number
+    isArray: boolean
+    isRelative: boolean
+    index?: number | undefined
+}
+
 export class HIDAsync extends EventEmitter {
     private constructor()
 
@@ -55,10 +146,115 @@ export class HIDAsync extends EventEmitter {
     getFeatureReport(report_id: number, report_length: number): Promise<Buffer>
     resume(): void
     write(values: number[] | Buffer): Promise<number>
+    writeMany(reports: Array<number[] | Buffer>): Promise<number[]>
+    writeMany(data: Buffer, stride: number): Promise<number[]>
+    writeLatest(values: number[] | Buffer, key?: number): Promise<number | 'coalesced'>
     setNonBlocking(no_block: boolean): Promise<void>
     getDeviceInfo(): Promise<Device>
+    getReportDescriptor(): Promise<Buffer>
+    getReportFields(): Promise<ReportField[]>
+    setReadOptions(options: ReadOptions): void
+    on(event: 'data', listener: (data: Buffer, receivedAt: number, sequence: number) => void): this
+    on(event: 'batch', listener: (data: Buffer, offsets: Uint32Array, stamps: Float64Array) => void): this
+    on(event: 'values', listener: (values: Int32Array, reportId: number, receivedAt: number, sequence: number) => void): this
+    on(event: 'feature', listener: (reportId: number, data: Buffer, receivedAt: number) => void): this
+    on(event: 'message', listener: (command: number, payload: Buffer, receivedAt: number, sequence: number) => void): this
+    on(event: string | symbol, listener: (...args: any[]) => void): this
+    subscribe(reportId: number, listener: (data: Buffer, values: Int32Array | undefined, receivedAt: number, sequence: number) => void): () => void
+    readRing(buffer: SharedArrayBuffer, options?: ReadOptions): void
+    trackLatest(options?: ReadOptions): void
+    transact(request: number[] | Buffer, options?: TransactOptions): Promise<Buffer>
+    getLatestReport(reportId: number, target: Uint8Array, meta?: Float64Array): number | null
+    pollFeatureReport(reportId: number, length: number, intervalMs: number): void
+    stopFeaturePoll(reportId?: number): void
+    startSchedule(frames: Uint8Array, options: { rate: number, frameSize?: number | undefined }): void
+    stopSchedule(): Promise<void>
+    setFramer(config: FramerConfig | null): void
+    sendMessage(command: number, payload?: number[] | Buffer): Promise<number[]>
+    getStats(): DeviceStats
 }
 
-export function setDriverType(type: 'hidraw' | 'libusb'): void
+export class HIDRing {
+    constructor(buffer: SharedArrayBuffer)
+
+    static byteLength(slots: number, reportLength: number): number
+
+    readonly state: 'starting' | 'running' | 'stopped' | 'error'
+    readonly dropped: number
+    readonly available: number
+    sequence: number | undefined
+    receivedAt: number | undefined
+    read(): Buffer | undefined
+    read(target: Uint8Array): number | undefined
+}
+
+export function setDriverType(type: 'hidraw' | 'libusb' | 'mock'): void
+
+export interface WatchFilter {
+    vendorId?: number | undefined
+    productId?: number | undefined
+    usagePage?: number | undefined
+    usage?: number | undefined
+    interval?: number | undefined
+}
+
+export class HIDWatcher extends EventEmitter {
+    private constructor()
+
+    on(event: 'attach' | 'detach', listener: (device: Device) => void): this
+    on(event: 'error', listener: (error: any) => void): this
+    close(): void
+}
+
+export function watch(filter?: WatchFilter): HIDWatcher
+
+export function setDevicesCache(ttl: number): void
+
+export function getStats(): GlobalStats
+
+export function setReadReactorThreads(threads: number): void
 
 export function getHidapiVersion(): string
+
+export interface MockDeviceOptions {
+    vendorId?: number | undefined
+    productId?: number | undefined
+    release?: number | undefined
+    usagePage?: number | undefined
+    usage?: number | undefined
+    interface?: number | undefined
+    serialNumber?: string | undefined
+    manufacturer?: string | undefined
+    product?: string | undefined
+    reportDescriptor?: number[] | Buffer | undefined
+    inputReportSize?: number | undefined
+    inputReportId?: number | undefined
+    reportsPerSecond?: number | undefined
+    loopback?: boolean | undefined
+    readLatencyUs?: number | undefined
+    writeLatencyUs?: number | undefined
+    failReadEvery?: number | undefined
+    failWriteEvery?: number | undefined
+    maxQueuedReports?: number | undefined
+}
+
+export interface MockDeviceStats {
+    reportsGenerated: number
+    reportsRead: number
+    reportsDropped: number
+    writes: number
+    bytesWritten: number
+    featureReportsSent: number
+    featureReportsRead: number
+    errorsInjected: number
+}
+
+export interface MockControl {
+    addDevice(options: MockDeviceOptions): string
+    removeDevice(path: string): boolean
+    pushInputReport(path: string, data: number[] | Buffer): void
+    getStats(path: string): MockDeviceStats
+    reset(): void
+}
+
+export function getMockControl(): MockControl
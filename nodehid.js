@@ -102,7 +102,7 @@ HID.prototype.resume = function resume() {
     {
         //Start polling & reading loop
         self._paused = false;
-        self.read(function readFunc(err, data) {
+        self.read(function readFunc(err, data, receivedAt, sequence) {
             try {
                 if (self._closing) {
                     // Discard any data if we're closing
@@ -131,7 +131,7 @@ HID.prototype.resume = function resume() {
                     if(!self._paused)
                         self.read(readFunc);
                     //Now emit the event
-                    self.emit("data", data);
+                    self.emit("data", data, receivedAt, sequence);
                 }
             } catch (e) {
                 // Emit an error on the device instead of propagating to a c++ exception
@@ -144,6 +144,11 @@ HID.prototype.resume = function resume() {
     }
 };
 
+// Events which need the device to be read from
+const readEvents = ["data", "batch", "values", "message"];
+// How long to keep reading once the last transaction has finished, in milliseconds
+const transactionIdleMs = 1000;
+
 class HIDAsync extends EventEmitter {
     constructor(raw) {
         super()
@@ -153,6 +158,15 @@ class HIDAsync extends EventEmitter {
         }
 
         this._raw = raw
+        // Listeners for reports with a particular id, by report id
+        this._subscriptions = new Map()
+        // Transactions waiting for their reply
+        this._transactions = 0
+        this._lastTransactionId = 0
+        // Keeps reading for a while after the last transaction, see transact()
+        this._transactionIdleTimer = null
+        // The callback of each feature report poll, by report id
+        this._featurePolls = new Map()
 
         /* Now we have `this._raw` Object from which we need to
             inherit.  So, one solution is to simply copy all
@@ -165,16 +179,19 @@ class HIDAsync extends EventEmitter {
             this[i] = async (...args) => this._raw[i](...args);
         }
 
-        /* Now upon adding a new listener for "data" events, we start
+        /* Now upon adding a new listener for "data", "batch", "values" or "message" events, we start
             the read thread executing. See `resume()` for more details.
         */
         this.on("newListener", (eventName, listener) =>{
-            if(eventName == "data")
-                process.nextTick(this.resume.bind(this) );
+            if(readEvents.includes(eventName))
+                process.nextTick(() => {
+                    this.resume();
+                    this._updateReportFilter();
+                });
         });
         this.on("removeListener", (eventName, listener) => {
-            if(eventName == "data" && this.listenerCount("data") == 0)
-                process.nextTick(this.pause.bind(this) );
+            if(readEvents.includes(eventName))
+                process.nextTick(() => this._readListenersChanged());
         })
     }
 
@@ -186,41 +203,484 @@ class HIDAsync extends EventEmitter {
 
     async close() {
         this._closing = true;
+        clearTimeout(this._transactionIdleTimer);
+        this._transactionIdleTimer = null;
+        this._featurePolls.clear();
         await this._raw.close();
         this.removeAllListeners();
         this._closed = true;
     }
-    
+
+    /* Configure how the read thread delivers reports. This takes effect the next
+        time reading is started, so should be called before adding a listener.
+        With `batchSize` > 1, reports that arrive together are delivered in one go:
+        "batch" listeners receive a single Buffer plus a Uint32Array of offsets,
+        and "data" listeners receive each report as a slice of that Buffer.
+        With `decode`, "values" listeners receive the input fields of each report
+        decoded into an Int32Array, which is reused for every report. This is
+        turned on automatically if there are "values" listeners when reading starts.
+    */
+    setReadOptions(options) {
+        this._readOptions = options;
+    }
+
+    /* Split messages across several reports when sending, and put them back together
+        when reading, in the style of CTAPHID. While a framer is set, "message" listeners
+        receive `(command, payload, receivedAt, sequence)` for each complete message,
+        in place of "data" events. Pass null to stop framing. Like `setReadOptions()`,
+        this takes effect the next time reading is started.
+    */
+    setFramer(config) {
+        this._framer = config || undefined;
+    }
+
+    /* Send a message through the framer set with `setFramer()`. Its packets are
+        written together, so can't be interleaved with other writes to the device.
+        Resolves with the number of bytes written for each packet.
+    */
+    async sendMessage(command, payload) {
+        if (!this._framer)
+            throw new Error("sendMessage needs a framer, set with setFramer()");
+        return this._raw.sendMessage(this._framer, command, payload || []);
+    }
+
+    /* Write reports at a fixed rate from a native thread, for keep-alives and
+        animations. `frames` is a Uint8Array holding one or more reports of
+        `options.frameSize` bytes (default the whole array), sent in turn at
+        `options.rate` per second. The frames are read directly from `frames` on
+        each tick, so update them in place to change what is sent. Stop with
+        `stopSchedule()` or `close()`.
+    */
+    startSchedule(frames, options) {
+        options = options || {};
+        this._raw.startSchedule(frames, options.frameSize || (frames && frames.length), options.rate);
+    }
+
+    /* Poll the feature report `reportId` every `intervalMs` milliseconds on the io thread
+        of the device, reading up to `length` bytes. "feature" listeners receive
+        `(reportId, data, receivedAt)` only when the report has changed, so javascript
+        only runs for changes. Polling the same report again replaces the previous poll.
+        A failure is emitted as an error, and stops the poll.
+    */
+    pollFeatureReport(reportId, length, intervalMs) {
+        const callback = (err, data, receivedAt) => {
+            try {
+                if (err) {
+                    // The poll has stopped, so release it unless it has already been replaced
+                    if (this._featurePolls.get(reportId) === callback) {
+                        this._featurePolls.delete(reportId);
+                        this._raw.stopFeaturePoll(reportId);
+                    }
+                    if (!this._closing)
+                        this.emit("error", err);
+                } else {
+                    this.emit("feature", reportId, data, receivedAt);
+                }
+            } catch (e) {
+                // Emit an error on the device instead of propagating to a c++ exception
+                setImmediate(() => {
+                    if (!this._closing)
+                        this.emit("error", e);
+                });
+            }
+        };
+        this._raw.pollFeatureReport(reportId, length, intervalMs, callback);
+        this._featurePolls.set(reportId, callback);
+    }
+
+    // Stop polling the feature report `reportId`, or every feature report when not given
+    stopFeaturePoll(reportId) {
+        if (reportId === undefined)
+            this._featurePolls.clear();
+        else
+            this._featurePolls.delete(reportId);
+        this._raw.stopFeaturePoll(reportId);
+    }
+
+    // Get the counters and latency histograms for this device. This is synchronous, unlike the native methods above
+    getStats() {
+        return this._raw.getStats();
+    }
+
+    /* Receive only the input reports with the given report id, as `listener(data, values)`.
+        While there are no "data", "batch" or "values" listeners, reports with ids that
+        nothing is subscribed to are dropped by the read thread, without waking javascript.
+        `values` is only set when reports are being decoded. Returns a function which
+        removes the subscription.
+    */
+    subscribe(reportId, listener) {
+        if (!Number.isInteger(reportId) || reportId < 0 || reportId > 255)
+            throw new TypeError("reportId must be a number from 0 to 255");
+        if (typeof listener !== "function")
+            throw new TypeError("listener must be a function");
+        if (this._readOptions && this._readOptions.batchSize > 1)
+            throw new TypeError("subscribe cannot be used with batchSize");
+
+        let listeners = this._subscriptions.get(reportId);
+        if (!listeners) {
+            listeners = new Set();
+            this._subscriptions.set(reportId, listeners);
+        }
+        listeners.add(listener);
+
+        if (this._reading)
+            this._updateReportFilter();
+        else
+            process.nextTick(this.resume.bind(this));
+
+        return () => {
+            if (listeners.delete(listener)) {
+                if (listeners.size === 0)
+                    this._subscriptions.delete(reportId);
+                process.nextTick(() => this._readListenersChanged());
+            }
+        };
+    }
+
+    /* Read reports into a SharedArrayBuffer instead of emitting events, so that
+        no javascript runs per report. Consume it with `HIDRing`, which can be
+        used from a worker_thread. The ring is laid out when reading starts, and
+        reading continues until `pause()` or `close()`. Errors are still emitted.
+    */
+    readRing(buffer, options) {
+        if (!(buffer instanceof SharedArrayBuffer))
+            throw new TypeError("readRing needs a SharedArrayBuffer");
+
+        this._readWithoutEvents(Object.assign({}, options, { ring: new Uint8Array(buffer) }));
+    }
+
+    /* Keep only the latest report of each report id, instead of emitting events,
+        to be fetched with `getLatestReport()`. Reading continues until `pause()`
+        or `close()`. Errors are still emitted.
+    */
+    trackLatest(options) {
+        this._readWithoutEvents(Object.assign({}, options, { latest: true }));
+    }
+
+    /* Copy the latest report with `reportId` into the Uint8Array `target`, returning
+        its length, or null if none has been read. This is synchronous. `meta` can be
+        a Float64Array, which receives the time the report was read in nanoseconds
+        (on the clock of `process.hrtime()`) and its sequence number.
+    */
+    getLatestReport(reportId, target, meta) {
+        return this._raw.getLatestReport(reportId, target, meta);
+    }
+
+    // Start a read which doesn't deliver reports through the callback
+    _readWithoutEvents(options) {
+        if (this._reading)
+            throw new Error("read is already running");
+
+        this._raw.readStart((err) => {
+            this._reading = false;
+            if (err && !this._closing)
+                this.emit("error", err);
+        }, options);
+        this._reading = true;
+    }
+
+    /* Write `request`, and resolve with the input report that replies to it.
+        The reply is picked out by the read thread, while any other reading carries
+        on, so many transactions can be in flight at once. A report is the reply when
+        its bytes from `match.offset` (default 0) equal `match.bytes`, or when not
+        given, the same `match.length` (default 1) bytes of the request. By default,
+        that is the report id. Rejects after `timeout` milliseconds (default 1000).
+    */
+    async transact(request, options) {
+        options = options || {};
+        const match = options.match || {};
+        const offset = match.offset || 0;
+        const bytes = match.bytes || Buffer.from(request).subarray(offset, offset + (match.length || 1));
+
+        this._lastTransactionId = (this._lastTransactionId % 0xFFFFFFFF) + 1;
+        const id = this._lastTransactionId;
+
+        // The reply can only be found while reading
+        this._transactions++;
+        clearTimeout(this._transactionIdleTimer);
+        this._transactionIdleTimer = null;
+        let timer;
+        try {
+            this.resume();
+            const reply = this._raw.transact(id, request, offset, bytes);
+            timer = setTimeout(() => this._raw.cancelTransaction(id), options.timeout || 1000);
+            return await reply;
+        } finally {
+            clearTimeout(timer);
+            if (--this._transactions === 0 && !this._closing) {
+                // Keep reading for a while, so that a run of transactions doesn't restart the read each time
+                this._transactionIdleTimer = setTimeout(() => {
+                    this._transactionIdleTimer = null;
+                    this._readListenersChanged();
+                }, transactionIdleMs);
+                this._transactionIdleTimer.unref();
+            }
+        }
+    }
+
+    _hasReadListeners() {
+        return this._transactions > 0 || this._transactionIdleTimer !== null || this._subscriptions.size > 0 || readEvents.some((eventName) => this.listenerCount(eventName) > 0);
+    }
+
+    // The report ids the read thread should pass on, or null for all of them
+    _reportFilter() {
+        if (readEvents.some((eventName) => this.listenerCount(eventName) > 0))
+            return null;
+        return Array.from(this._subscriptions.keys());
+    }
+
+    _updateReportFilter() {
+        if (this._reading)
+            this._raw.setReportIds(this._reportFilter());
+    }
+
+    _readListenersChanged() {
+        if (!this._hasReadListeners()) {
+            if (this._reading)
+                this.pause();
+        } else {
+            this._updateReportFilter();
+        }
+    }
+
     //Pauses the reader, which stops "data" events from being emitted
     pause() {
+        this._reading = false;
         this._raw.readStop();
     }
 
     resume() {
-        if(this.listenerCount("data") > 0)
+        if(!this._reading && this._hasReadListeners())
         {
+            let options = this._readOptions;
+            if (this.listenerCount("values") > 0 && !(options && options.decode)) {
+                options = Object.assign({}, options, { decode: true });
+            }
+            const reportIds = this._reportFilter();
+            if (reportIds) {
+                options = Object.assign({}, options, { reportIds });
+            }
+            const framing = !!this._framer;
+            if (framing) {
+                options = Object.assign({}, options, { framer: this._framer });
+            }
+
             //Start polling & reading loop
-            this._raw.readStart((err, data) => {
-                try {
-                    if (err) {
-                        if(!this._closing)
-                            this.emit("error", err);
-                        //else ignore any errors if I'm closing the device
-                    } else {
-                        this.emit("data", data);
+            try {
+                this._raw.readStart((err, data, offsets, values, reportId, receivedAt, sequence) => {
+                    try {
+                        if (err) {
+                            this._reading = false;
+                            if(!this._closing)
+                                this.emit("error", err);
+                            //else ignore any errors if I'm closing the device
+                        } else if (framing) {
+                            // For a message, reportId holds its command
+                            this.emit("message", reportId, data, receivedAt, sequence);
+                        } else if (offsets) {
+                            // For a batch, receivedAt holds the time and sequence number of each report
+                            const stamps = receivedAt;
+                            this.emit("batch", data, offsets, stamps);
+                            if (this.listenerCount("data") > 0) {
+                                for (let i = 0; i + 1 < offsets.length; i++) {
+                                    this.emit("data", data.subarray(offsets[i], offsets[i + 1]), stamps[i * 2], stamps[i * 2 + 1]);
+                                }
+                            }
+                        } else {
+                            this.emit("data", data, receivedAt, sequence);
+                            if (values)
+                                this.emit("values", values, reportId, receivedAt, sequence);
+
+                            const listeners = this._subscriptions.get(reportId);
+                            if (listeners) {
+                                for (const listener of listeners) {
+                                    listener(data, values, receivedAt, sequence);
+                                }
+                            }
+                        }
+                    } catch (e) {
+                        // Emit an error on the device instead of propagating to a c++ exception
+                        setImmediate(() => {
+                            if (!this._closing)
+                                this.emit("error", e);
+                        });
                     }
-                } catch (e) {
-                    // Emit an error on the device instead of propagating to a c++ exception
-                    setImmediate(() => {
-                        if (!this._closing)
-                            this.emit("error", e);
-                    });
+                }, options)
+                this._reading = true;
+            } catch (e) {
+                if (!this._closing)
+                    this.emit("error", e);
+            }
+        }
+    }
+}
+
+// Layout of the header of a ring, in 32 bit words. This must match read.h
+const RING_HEAD = 0;
+const RING_TAIL = 1;
+const RING_SLOT_COUNT = 2;
+const RING_SLOT_SIZE = 3;
+const RING_DROPPED = 4;
+const RING_STATE = 5;
+const RING_HEADER_SIZE = 64;
+const RING_SLOT_HEADER_SIZE = 16;
+const ringStates = ["starting", "running", "stopped", "error"];
+
+/* Consumes the reports written into a SharedArrayBuffer by `HIDAsync.readRing()`.
+    This only touches the buffer, so it can be constructed in a worker_thread
+    from the same SharedArrayBuffer. There must only be one consumer of a ring.
+    The read thread can't wake `Atomics.wait`, so poll `read()` instead.
+*/
+class HIDRing {
+    constructor(buffer) {
+        this._header = new Uint32Array(buffer, 0, RING_HEADER_SIZE / 4);
+        // Views over the whole ring, so that reading a report doesn't need new ones. Slots are 8 byte aligned
+        this._words = new Uint32Array(buffer, 0, buffer.byteLength >>> 2);
+        this._bytes = Buffer.from(buffer);
+    }
+
+    // How large a SharedArrayBuffer needs to be to hold `slots` reports of up to `reportLength` bytes
+    static byteLength(slots, reportLength) {
+        return RING_HEADER_SIZE + slots * ((RING_SLOT_HEADER_SIZE + reportLength + 7) & ~7);
+    }
+
+    get state() {
+        return ringStates[Atomics.load(this._header, RING_STATE)];
+    }
+
+    // Reports discarded because the ring was full
+    get dropped() {
+        return Atomics.load(this._header, RING_DROPPED);
+    }
+
+    // How many reports are waiting to be read
+    get available() {
+        if (Atomics.load(this._header, RING_STATE) === 0) return 0;
+        return (Atomics.load(this._header, RING_HEAD) - Atomics.load(this._header, RING_TAIL)) >>> 0;
+    }
+
+    /* Take the oldest waiting report, or return undefined if there are none.
+        With `target`, the report is copied into it and the length is returned,
+        so that nothing is allocated. Otherwise a new Buffer is returned.
+        `sequence` is set to the sequence number of the report, and `receivedAt`
+        to when it was read, in nanoseconds on the clock of `process.hrtime()`.
+        Like the `receivedAt` of `data` events this is a double, which rounds
+        the time once the system has been up for more than 2^53 ns (~104 days).
+    */
+    read(target) {
+        if (this.available === 0) return undefined;
+
+        const tail = Atomics.load(this._header, RING_TAIL);
+        const slotCount = this._header[RING_SLOT_COUNT];
+        const offset = RING_HEADER_SIZE + (tail % slotCount) * this._header[RING_SLOT_SIZE];
+        const word = offset >>> 2;
+        const start = offset + RING_SLOT_HEADER_SIZE;
+        const length = this._words[word + 1];
+        this.sequence = this._words[word];
+        this.receivedAt = this._words[word + 2] + this._words[word + 3] * 0x100000000;
+
+        let result;
+        if (target) {
+            result = this._bytes.copy(target, 0, start, start + Math.min(length, target.length));
+        } else {
+            result = Buffer.from(this._bytes.subarray(start, start + length));
+        }
+
+        // Hand the slot back to the read thread
+        Atomics.store(this._header, RING_TAIL, (tail + 1) >>> 0);
+        return result;
+    }
+}
+
+function deviceKey(device) {
+    return `${device.path}:${device.usagePage}:${device.usage}`;
+}
+
+//Emits 'attach' and 'detach' events for devices matching the filter
+class HIDWatcher extends EventEmitter {
+    constructor(filter) {
+        super()
+
+        this._filter = filter || {};
+
+        loadBinding();
+        if (binding.watchDevices) {
+            this._stop = binding.watchDevices((err, attached, detached) => {
+                if (err) {
+                    this.emit("error", err);
+                    return;
                 }
-            })
+                for (const device of detached) {
+                    if (this._matches(device)) this.emit("detach", device);
+                }
+                for (const device of attached) {
+                    if (this._matches(device)) this.emit("attach", device);
+                }
+            });
+        } else {
+            // No native support, so poll for changes instead
+            this._known = null;
+            this._polling = false;
+            this._timer = setInterval(() => this._poll(), this._filter.interval || 1000);
+            this._poll();
+        }
+    }
+
+    _matches(device) {
+        const filter = this._filter;
+        return (filter.vendorId === undefined || device.vendorId === filter.vendorId) &&
+            (filter.productId === undefined || device.productId === filter.productId) &&
+            (filter.usagePage === undefined || device.usagePage === filter.usagePage) &&
+            (filter.usage === undefined || device.usage === filter.usage);
+    }
+
+    async _poll() {
+        if (this._polling) return;
+        this._polling = true;
+
+        try {
+            const devices = await binding.devicesAsync();
+            if (!this._timer) return;
+
+            const current = new Map();
+            for (const device of devices) {
+                if (this._matches(device)) current.set(deviceKey(device), device);
+            }
+
+            // The first poll only records what is already attached
+            if (this._known) {
+                for (const [key, device] of this._known) {
+                    if (!current.has(key)) this.emit("detach", device);
+                }
+                for (const [key, device] of current) {
+                    if (!this._known.has(key)) this.emit("attach", device);
+                }
+            }
+            this._known = current;
+        } catch (e) {
+            if (this._timer) this.emit("error", e);
+        } finally {
+            this._polling = false;
+        }
+    }
+
+    close() {
+        if (this._stop) {
+            this._stop();
+            this._stop = null;
         }
+        if (this._timer) {
+            clearInterval(this._timer);
+            this._timer = null;
+        }
+        this.removeAllListeners();
     }
 }
 
+function watch(filter) {
+    return new HIDWatcher(filter);
+}
+
 function showdevices() {
     loadBinding();
     return binding.devices.apply(HID,arguments);
@@ -231,6 +691,29 @@ function showdevicesAsync(...args) {
     return binding.devicesAsync(...args);
 }
 
+function setDevicesCache(ttl) {
+    loadBinding();
+    binding.setDevicesCache(ttl);
+}
+
+function getStats() {
+    loadBinding();
+    return binding.getStats();
+}
+
+function setReadReactorThreads(threads) {
+    loadBinding();
+    binding.setReadReactorThreads(threads);
+}
+
+function getMockControl() {
+    loadBinding();
+    if (!binding.mock) {
+        throw new Error("node-hid was not built with the mock driver");
+    }
+    return binding.mock;
+}
+
 function getHidapiVersion() {
     loadBinding();
     return binding.hidapiVersion;
@@ -239,7 +722,13 @@ function getHidapiVersion() {
 //Expose API
 exports.HID = HID;
 exports.HIDAsync = HIDAsync;
+exports.HIDRing = HIDRing;
 exports.devices = showdevices;
 exports.devicesAsync = showdevicesAsync;
 exports.setDriverType = setDriverType;
+exports.watch = watch;
+exports.setDevicesCache = setDevicesCache;
+exports.getStats = getStats;
+exports.setReadReactorThreads = setReadReactorThreads;
 exports.getHidapiVersion = getHidapiVersion;
+exports.getMockControl = getMockControl;
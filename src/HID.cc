@@ -27,7 +27,7 @@
 #include "util.h"
 #include "HID.h"
 
-#if defined(__APPLE__)
+#if defined(__APPLE__) && !defined(NODE_HID_MOCK)
 #include "../hidapi/mac/hidapi_darwin.h"
 #endif
 
@@ -65,7 +65,7 @@ HID::HID(const Napi::CallbackInfo &info)
     {
       argsLength -= 1;
 
-#if defined(__APPLE__)
+#if defined(__APPLE__) && !defined(NODE_HID_MOCK)
       Napi::Object options = info[argsLength].As<Napi::Object>();
       Napi::Value isNonExclusiveMode = options.Get("nonExclusive");
       if (!isNonExclusiveMode.IsBoolean())
@@ -78,7 +78,7 @@ HID::HID(const Napi::CallbackInfo &info)
     }
   }
 
-#if defined(__APPLE__)
+#if defined(__APPLE__) && !defined(NODE_HID_MOCK)
   hid_darwin_set_open_exclusive(isNonExclusiveBool ? 0 : 1);
 #else
   // silence unused variable warning
@@ -134,10 +134,26 @@ HID::HID(const Napi::CallbackInfo &info)
       return;
     }
   }
+
+  _appCtx = appCtx;
+  _appCtx->stats.add(&_stats);
 }
 
 void HID::closeHandle()
 {
+  // A queued ReadWorker keeps its own reference, so make sure it gives up instead of reading from the closed handle
+  _readInterrupt = true;
+  if (_reader)
+  {
+    _reader->Interrupt();
+    _reader = nullptr;
+  }
+
+  if (_appCtx)
+  {
+    _appCtx->stats.remove(&_stats);
+  }
+
   if (_hidHandle)
   {
     hid_close(_hidHandle);
@@ -145,11 +161,20 @@ void HID::closeHandle()
   }
 }
 
+std::shared_ptr<InterruptibleReader> HID::reader()
+{
+  if (!_reader)
+  {
+    _reader = std::make_shared<InterruptibleReader>(_hidHandle, &_stats);
+  }
+  return _reader;
+}
+
 class ReadWorker : public Napi::AsyncWorker
 {
 public:
-  ReadWorker(HID *hid, Napi::Function &callback)
-      : Napi::AsyncWorker(hid->Value(), callback), _hid(hid) {}
+  ReadWorker(HID *hid, std::shared_ptr<InterruptibleReader> reader, Napi::Function &callback)
+      : Napi::AsyncWorker(hid->Value(), callback), _hid(hid), _reader(std::move(reader)) {}
 
   ~ReadWorker()
   {
@@ -167,15 +192,19 @@ public:
       return;
     }
 
-    int mswait = 50;
-    while (len == 0 && !_hid->_readInterrupt && _hid->_hidHandle != nullptr)
+    while (len == 0 && !_hid->_readInterrupt && _hid->_hidHandle != nullptr && _reader != nullptr)
     {
-      len = hid_read_timeout(_hid->_hidHandle, buf, READ_BUFF_MAXSIZE, mswait);
+      len = _reader->Read(buf, READ_BUFF_MAXSIZE, -1);
     }
     if (len <= 0)
     {
       SetError("could not read from HID device");
     }
+    else
+    {
+      receivedAt = _reader->ReceivedAt();
+      sequence = _reader->Sequence();
+    }
 
     _hid->_readRunning = false;
   }
@@ -183,13 +212,16 @@ public:
   void OnOK() override
   {
     auto buffer = Napi::Buffer<unsigned char>::Copy(Env(), buf, len);
-    Callback().Call({Env().Null(), buffer});
+    Callback().Call({Env().Null(), buffer, Napi::Number::New(Env(), (double)receivedAt), Napi::Number::New(Env(), (double)sequence)});
   }
 
 private:
   HID *_hid;
+  std::shared_ptr<InterruptibleReader> _reader;
   unsigned char *buf = new unsigned char[READ_BUFF_MAXSIZE];
   int len = 0;
+  uint64_t receivedAt = 0;
+  uint64_t sequence = 0;
 };
 
 Napi::Value HID::read(const Napi::CallbackInfo &info)
@@ -204,8 +236,15 @@ Napi::Value HID::read(const Napi::CallbackInfo &info)
 
   this->_readInterrupt = false;
 
+  std::shared_ptr<InterruptibleReader> reader;
+  if (_hidHandle && !_readRunning)
+  {
+    reader = this->reader();
+    reader->Reset();
+  }
+
   auto callback = info[0].As<Napi::Function>();
-  auto job = new ReadWorker(this, callback);
+  auto job = new ReadWorker(this, reader, callback);
   job->Queue();
 
   return env.Null();
@@ -216,6 +255,10 @@ Napi::Value HID::readInterrupt(const Napi::CallbackInfo &info)
   Napi::Env env = info.Env();
 
   this->_readInterrupt = true;
+  if (_reader)
+  {
+    _reader->Interrupt();
+  }
 
   return env.Null();
 }
@@ -236,8 +279,17 @@ Napi::Value HID::readSync(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
+  if (_readRunning)
+  {
+    Napi::TypeError::New(env, "Cannot use readSync while async read is running").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto reader = this->reader();
+  reader->Reset();
+
   unsigned char buff_read[READ_BUFF_MAXSIZE];
-  int returnedLength = hid_read(_hidHandle, buff_read, sizeof buff_read);
+  int returnedLength = reader->Read(buff_read, sizeof buff_read, _nonBlocking ? 0 : -1);
   if (returnedLength == -1)
   {
     Napi::TypeError::New(env, "could not read data from device").ThrowAsJavaScriptException();
@@ -268,9 +320,18 @@ Napi::Value HID::readTimeout(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
+  if (_readRunning)
+  {
+    Napi::TypeError::New(env, "Cannot use readTimeout while async read is running").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto reader = this->reader();
+  reader->Reset();
+
   const int timeout = info[0].As<Napi::Number>().Uint32Value();
   unsigned char buff_read[READ_BUFF_MAXSIZE];
-  int returnedLength = hid_read_timeout(_hidHandle, buff_read, sizeof buff_read, timeout);
+  int returnedLength = reader->Read(buff_read, sizeof buff_read, timeout);
   if (returnedLength == -1)
   {
     Napi::TypeError::New(env, "could not read data from device").ThrowAsJavaScriptException();
@@ -285,6 +346,83 @@ Napi::Value HID::readTimeout(const Napi::CallbackInfo &info)
   return retval;
 }
 
+Napi::Value HID::readSyncInto(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  unsigned char *buf;
+  size_t bufSize;
+  std::string bufferError = info.Length() == 1 ? getTargetBuffer(info[0], buf, bufSize) : "readSyncInto needs a buffer parameter";
+  if (bufferError != "")
+  {
+    Napi::TypeError::New(env, bufferError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (!_hidHandle)
+  {
+    Napi::TypeError::New(env, "Cannot access closed device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (_readRunning)
+  {
+    Napi::TypeError::New(env, "Cannot use readSyncInto while async read is running").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto reader = this->reader();
+  reader->Reset();
+
+  int returnedLength = reader->Read(buf, bufSize, _nonBlocking ? 0 : -1);
+  if (returnedLength == -1)
+  {
+    Napi::TypeError::New(env, "could not read data from device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return Napi::Number::New(env, returnedLength);
+}
+
+Napi::Value HID::readTimeoutInto(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  unsigned char *buf;
+  size_t bufSize;
+  std::string bufferError = info.Length() == 2 && info[1].IsNumber() ? getTargetBuffer(info[0], buf, bufSize) : "readTimeoutInto needs buffer and time out parameters";
+  if (bufferError != "")
+  {
+    Napi::TypeError::New(env, bufferError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (!_hidHandle)
+  {
+    Napi::TypeError::New(env, "Cannot access closed device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (_readRunning)
+  {
+    Napi::TypeError::New(env, "Cannot use readTimeoutInto while async read is running").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto reader = this->reader();
+  reader->Reset();
+
+  const int timeout = info[1].As<Napi::Number>().Uint32Value();
+  int returnedLength = reader->Read(buf, bufSize, timeout);
+  if (returnedLength == -1)
+  {
+    Napi::TypeError::New(env, "could not read data from device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return Napi::Number::New(env, returnedLength);
+}
+
 Napi::Value HID::getFeatureReport(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
@@ -312,7 +450,9 @@ Napi::Value HID::getFeatureReport(const Napi::CallbackInfo &info)
   std::vector<unsigned char> buf(bufSize);
   buf[0] = reportId;
 
+  uint64_t startedAt = monotonicNow();
   int returnedLength = hid_get_feature_report(_hidHandle, buf.data(), bufSize);
+  _stats.countFeature(returnedLength, startedAt);
   if (returnedLength == -1)
   {
     Napi::TypeError::New(env, "could not get feature report from device").ThrowAsJavaScriptException();
@@ -327,6 +467,39 @@ Napi::Value HID::getFeatureReport(const Napi::CallbackInfo &info)
   return retval;
 }
 
+Napi::Value HID::getFeatureReportInto(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  unsigned char *buf;
+  size_t bufSize;
+  std::string bufferError = info.Length() == 2 && info[0].IsNumber() ? getTargetBuffer(info[1], buf, bufSize) : "need report ID and buffer parameters in getFeatureReportInto";
+  if (bufferError != "")
+  {
+    Napi::TypeError::New(env, bufferError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (!_hidHandle)
+  {
+    Napi::TypeError::New(env, "Cannot access closed device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  buf[0] = info[0].As<Napi::Number>().Uint32Value();
+
+  uint64_t startedAt = monotonicNow();
+  int returnedLength = hid_get_feature_report(_hidHandle, buf, bufSize);
+  _stats.countFeature(returnedLength, startedAt);
+  if (returnedLength == -1)
+  {
+    Napi::TypeError::New(env, "could not get feature report from device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return Napi::Number::New(env, returnedLength);
+}
+
 Napi::Value HID::sendFeatureReport(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
@@ -351,7 +524,9 @@ Napi::Value HID::sendFeatureReport(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
+  uint64_t startedAt = monotonicNow();
   int returnedLength = hid_send_feature_report(_hidHandle, message.data(), message.size());
+  _stats.countFeature(returnedLength, startedAt);
   if (returnedLength == -1)
   { // Not sure if there would ever be a valid return value of 0.
     Napi::TypeError::New(env, "could not send feature report to device").ThrowAsJavaScriptException();
@@ -398,6 +573,7 @@ Napi::Value HID::setNonBlocking(const Napi::CallbackInfo &info)
     Napi::TypeError::New(env, "Error setting non-blocking mode.").ThrowAsJavaScriptException();
     return env.Null();
   }
+  _nonBlocking = blockStatus != 0;
 
   return env.Null();
 }
@@ -426,7 +602,9 @@ Napi::Value HID::write(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
+  uint64_t startedAt = monotonicNow();
   int returnedLength = hid_write(_hidHandle, message.data(), message.size());
+  _stats.countWrite(returnedLength, startedAt);
   if (returnedLength < 0)
   {
     Napi::TypeError::New(env, "Cannot write to hid device").ThrowAsJavaScriptException();
@@ -436,6 +614,42 @@ Napi::Value HID::write(const Napi::CallbackInfo &info)
   return Napi::Number::New(env, returnedLength);
 }
 
+Napi::Value HID::writeMany(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  std::vector<unsigned char> data;
+  std::vector<size_t> offsets;
+  std::string copyError = copyReportsIntoVector(info, data, offsets);
+  if (copyError != "")
+  {
+    Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (!_hidHandle)
+  {
+    Napi::TypeError::New(env, "Cannot write to closed device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  Napi::Array result = Napi::Array::New(env, offsets.size() - 1);
+  for (size_t i = 0; i + 1 < offsets.size(); i++)
+  {
+    uint64_t startedAt = monotonicNow();
+    int returnedLength = hid_write(_hidHandle, data.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    _stats.countWrite(returnedLength, startedAt);
+    if (returnedLength < 0)
+    {
+      Napi::TypeError::New(env, "Cannot write report " + std::to_string(i) + " to hid device").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    result.Set(i, Napi::Number::New(env, returnedLength));
+  }
+
+  return result;
+}
+
 Napi::Value HID::getDeviceInfo(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
@@ -456,6 +670,62 @@ Napi::Value HID::getDeviceInfo(const Napi::CallbackInfo &info)
   return generateDeviceInfo(env, dev);
 }
 
+Napi::Value HID::getReportDescriptor(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle)
+  {
+    Napi::TypeError::New(env, "Cannot access closed device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::vector<unsigned char> descriptor;
+  std::string error = ::getReportDescriptor(_hidHandle, descriptor);
+  if (error != "")
+  {
+    Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return Napi::Buffer<unsigned char>::Copy(env, descriptor.data(), descriptor.size());
+}
+
+Napi::Value HID::getReportFields(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle)
+  {
+    Napi::TypeError::New(env, "Cannot access closed device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::vector<unsigned char> descriptor;
+  ReportDescriptor parsed;
+  std::string error = ::getReportDescriptor(_hidHandle, descriptor);
+  if (error == "")
+  {
+    error = parseReportDescriptor(descriptor.data(), descriptor.size(), parsed);
+  }
+  if (error != "")
+  {
+    Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return generateReportFields(env, parsed);
+}
+
+Napi::Value HID::getStats(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  StatsSnapshot stats;
+  _stats.addTo(stats);
+  return generateStatsObject(env, stats);
+}
+
 Napi::Value HID::Initialize(Napi::Env &env)
 {
 
@@ -464,12 +734,19 @@ Napi::Value HID::Initialize(Napi::Env &env)
                                                     InstanceMethod("read", &HID::read),
                                                     InstanceMethod("readInterrupt", &HID::readInterrupt),
                                                     InstanceMethod("write", &HID::write, napi_enumerable),
+                                                    InstanceMethod("writeMany", &HID::writeMany, napi_enumerable),
                                                     InstanceMethod("getFeatureReport", &HID::getFeatureReport, napi_enumerable),
                                                     InstanceMethod("sendFeatureReport", &HID::sendFeatureReport, napi_enumerable),
                                                     InstanceMethod("setNonBlocking", &HID::setNonBlocking, napi_enumerable),
                                                     InstanceMethod("readSync", &HID::readSync, napi_enumerable),
                                                     InstanceMethod("readTimeout", &HID::readTimeout, napi_enumerable),
+                                                    InstanceMethod("readSyncInto", &HID::readSyncInto, napi_enumerable),
+                                                    InstanceMethod("readTimeoutInto", &HID::readTimeoutInto, napi_enumerable),
+                                                    InstanceMethod("getFeatureReportInto", &HID::getFeatureReportInto, napi_enumerable),
                                                     InstanceMethod("getDeviceInfo", &HID::getDeviceInfo, napi_enumerable),
+                                                    InstanceMethod("getReportDescriptor", &HID::getReportDescriptor, napi_enumerable),
+                                                    InstanceMethod("getReportFields", &HID::getReportFields, napi_enumerable),
+                                                    InstanceMethod("getStats", &HID::getStats, napi_enumerable),
                                                 });
 
   return ctor;
@@ -1,4 +1,5 @@
 #include "util.h"
+#include "read.h"
 
 #include <atomic>
 
@@ -17,6 +18,17 @@ public:
     std::atomic<bool> _readRunning = {false};
     std::atomic<bool> _readInterrupt = {false};
 
+    // Once created, all reads go through this so that they can be interrupted
+    std::shared_ptr<InterruptibleReader> reader();
+
+private:
+    std::shared_ptr<InterruptibleReader> _reader;
+    bool _nonBlocking = false;
+
+    // Registered with the ApplicationContext while the device is open
+    std::shared_ptr<ApplicationContext> _appCtx;
+    DeviceStats _stats;
+
 private:
     static Napi::Value devices(const Napi::CallbackInfo &info);
 
@@ -24,10 +36,17 @@ private:
     Napi::Value read(const Napi::CallbackInfo &info);
     Napi::Value readInterrupt(const Napi::CallbackInfo &info);
     Napi::Value write(const Napi::CallbackInfo &info);
+    Napi::Value writeMany(const Napi::CallbackInfo &info);
     Napi::Value setNonBlocking(const Napi::CallbackInfo &info);
     Napi::Value getFeatureReport(const Napi::CallbackInfo &info);
+    Napi::Value getFeatureReportInto(const Napi::CallbackInfo &info);
     Napi::Value sendFeatureReport(const Napi::CallbackInfo &info);
     Napi::Value readSync(const Napi::CallbackInfo &info);
     Napi::Value readTimeout(const Napi::CallbackInfo &info);
+    Napi::Value readSyncInto(const Napi::CallbackInfo &info);
+    Napi::Value readTimeoutInto(const Napi::CallbackInfo &info);
     Napi::Value getDeviceInfo(const Napi::CallbackInfo &info);
+    Napi::Value getReportDescriptor(const Napi::CallbackInfo &info);
+    Napi::Value getReportFields(const Napi::CallbackInfo &info);
+    Napi::Value getStats(const Napi::CallbackInfo &info);
 };
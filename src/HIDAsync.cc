@@ -29,7 +29,7 @@
 #include "HIDAsync.h"
 #include "read.h"
 
-#if defined(__APPLE__)
+#if defined(__APPLE__) && !defined(NODE_HID_MOCK)
 #include "../hidapi/mac/hidapi_darwin.h"
 #endif
 
@@ -60,16 +60,25 @@ class CloseWorker : public PromiseAsyncWorker<std::shared_ptr<DeviceContext>>
 {
 public:
   CloseWorker(
-      Napi::Env &env, std::shared_ptr<DeviceContext> hid, std::shared_ptr<ReadThreadState> read_state)
+      Napi::Env &env, std::shared_ptr<DeviceContext> hid, std::shared_ptr<ReadThreadState> read_state, std::shared_ptr<OutputScheduler> scheduler, std::shared_ptr<Napi::ObjectReference> scheduleFrames)
       : PromiseAsyncWorker(env, hid),
-        read_state(std::move(read_state)) {}
+        read_state(std::move(read_state)),
+        scheduler(std::move(scheduler)),
+        scheduleFrames(std::move(scheduleFrames)) {}
 
   // This code will be executed on the worker thread. Note: Napi types cannot be used
   void Execute() override
   {
+    if (scheduler)
+    {
+      // The frames are released along with this job, once the scheduler has finished with them
+      scheduler->wait();
+      scheduler = nullptr;
+    }
+
     if (read_state)
     {
-      read_state->abort = true;
+      read_state->stop();
 
       // Wait for the thread to terminate
       read_state->wait();
@@ -91,16 +100,24 @@ public:
 
 private:
   std::shared_ptr<ReadThreadState> read_state;
+  std::shared_ptr<OutputScheduler> scheduler;
+  std::shared_ptr<Napi::ObjectReference> scheduleFrames;
 };
 
 void HIDAsync::closeHandle()
 {
   if (read_state)
   {
-    read_state->abort = true;
+    read_state->stop();
     read_state = nullptr;
   }
 
+  stopFeaturePolls();
+
+  // This waits for the scheduler thread, so that it is done with the frames before they are released
+  scheduler = nullptr;
+  scheduleFrames = nullptr;
+
   // hid_close is called by the destructor
   _hidHandle = nullptr;
 }
@@ -230,7 +247,7 @@ Napi::Value HIDAsync::Create(const Napi::CallbackInfo &info)
     {
       argsLength -= 1;
 
-#if defined(__APPLE__)
+#if defined(__APPLE__) && !defined(NODE_HID_MOCK)
       Napi::Object options = info[argsLength].As<Napi::Object>();
       Napi::Value isNonExclusiveMode = options.Get("nonExclusive");
       if (!isNonExclusiveMode.IsBoolean())
@@ -303,8 +320,53 @@ Napi::Value HIDAsync::readStart(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
+  if (info.Length() < 1 || !info[0].IsFunction())
+  {
+    Napi::TypeError::New(env, "need a callback function in readStart").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  ReadOptions options;
+  if (info.Length() > 1)
+  {
+    std::string optionsError = parseReadOptions(info[1], options);
+    if (optionsError != "")
+    {
+      Napi::TypeError::New(env, optionsError).ThrowAsJavaScriptException();
+      return env.Null();
+    }
+  }
+
   auto callback = info[0].As<Napi::Function>();
-  read_state = start_read_helper(env, _hidHandle, callback);
+  read_state = start_read_helper(env, _hidHandle, callback, options);
+
+  return env.Null();
+}
+
+Napi::Value HIDAsync::setReportIds(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  bool acceptAll = info.Length() < 1 || info[0].IsNull() || info[0].IsUndefined();
+  std::vector<unsigned char> ids;
+  if (!acceptAll)
+  {
+    std::string idsError = parseReportIds(info[0], ids);
+    if (idsError != "")
+    {
+      Napi::TypeError::New(env, idsError).ThrowAsJavaScriptException();
+      return env.Null();
+    }
+  }
+
+  // This only affects the current read, readStart must be given the ids for the next
+  if (read_state)
+  {
+    if (acceptAll)
+      read_state->reportFilter.acceptAll();
+    else
+      read_state->reportFilter.acceptOnly(ids);
+  }
 
   return env.Null();
 }
@@ -327,7 +389,7 @@ public:
   // This code will be executed on the worker thread. Note: Napi types cannot be used
   void Execute() override
   {
-    read_state->abort = true;
+    read_state->stop();
 
     // Wait for the thread to terminate
     read_state->wait();
@@ -354,7 +416,7 @@ Napi::Value HIDAsync::readStop(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
-  auto result = (new ReadStopWorker(env, std::move(_hidHandle), std::move(read_state)))->QueueAndRun();
+  auto result = (new ReadStopWorker(env, _hidHandle, std::move(read_state)))->QueueAndRun();
 
   // Ownership is transferred to ReadStopWorker
   read_state = nullptr;
@@ -396,6 +458,7 @@ public:
       {
         returnedLength = hid_read_timeout(context->hid, buffer, READ_BUFF_MAXSIZE, _timeout);
       }
+      context->stats.countRead(returnedLength);
 
       if (returnedLength < 0)
       {
@@ -481,7 +544,9 @@ public:
   {
     if (context->hid)
     {
+      uint64_t startedAt = monotonicNow();
       bufferLength = hid_get_feature_report(context->hid, buffer, bufferLength);
+      context->stats.countFeature(bufferLength, startedAt);
       if (bufferLength < 0)
       {
         SetError("could not get feature report from device");
@@ -538,16 +603,18 @@ public:
   SendFeatureReportWorker(
       Napi::Env &env,
       std::shared_ptr<DeviceContext> hid,
-      std::vector<unsigned char> srcBuffer)
+      WriteData &&srcBuffer)
       : PromiseAsyncWorker(env, hid),
-        srcBuffer(srcBuffer) {}
+        srcBuffer(std::move(srcBuffer)) {}
 
   // This code will be executed on the worker thread. Note: Napi types cannot be used
   void Execute() override
   {
     if (context->hid)
     {
+      uint64_t startedAt = monotonicNow();
       written = hid_send_feature_report(context->hid, srcBuffer.data(), srcBuffer.size());
+      context->stats.countFeature(written, startedAt);
       if (written < 0)
       {
         SetError("could not send feature report to device");
@@ -566,7 +633,7 @@ public:
 
 private:
   int written = 0;
-  std::vector<unsigned char> srcBuffer;
+  WriteData srcBuffer;
 };
 
 Napi::Value HIDAsync::sendFeatureReport(const Napi::CallbackInfo &info)
@@ -585,15 +652,15 @@ Napi::Value HIDAsync::sendFeatureReport(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
-  std::vector<unsigned char> message;
-  std::string copyError = copyArrayOrBufferIntoVector(info[0], message);
+  WriteData message;
+  std::string copyError = message.assign(info[0]);
   if (copyError != "")
   {
     Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
     return env.Null();
   }
 
-  return (new SendFeatureReportWorker(env, _hidHandle, message))->QueueAndRun();
+  return (new SendFeatureReportWorker(env, _hidHandle, std::move(message)))->QueueAndRun();
 }
 
 Napi::Value HIDAsync::close(const Napi::CallbackInfo &info)
@@ -611,11 +678,21 @@ Napi::Value HIDAsync::close(const Napi::CallbackInfo &info)
   // Mark it as closed, to stop new jobs being pushed to the queue
   _hidHandle->is_closed = true;
 
-  auto result = (new CloseWorker(env, std::move(_hidHandle), std::move(read_state)))->QueueAndRun();
+  if (scheduler)
+  {
+    scheduler->stop();
+  }
+
+  // Anything already polled is delivered before the close resolves
+  stopFeaturePolls();
+
+  auto result = (new CloseWorker(env, std::move(_hidHandle), std::move(read_state), std::move(scheduler), std::move(scheduleFrames)))->QueueAndRun();
 
   // Ownership is transferred to CloseWorker
   _hidHandle = nullptr;
   read_state = nullptr;
+  scheduler = nullptr;
+  scheduleFrames = nullptr;
 
   return result;
 }
@@ -683,16 +760,16 @@ public:
   WriteWorker(
       Napi::Env &env,
       std::shared_ptr<DeviceContext> hid,
-      std::vector<unsigned char> srcBuffer)
+      WriteData &&srcBuffer)
       : PromiseAsyncWorker(env, hid),
-        srcBuffer(srcBuffer) {}
+        srcBuffer(std::move(srcBuffer)) {}
 
   // This code will be executed on the worker thread. Note: Napi types cannot be used
   void Execute() override
   {
     if (context->hid)
     {
-      written = hid_write(context->hid, srcBuffer.data(), srcBuffer.size());
+      written = context->write(srcBuffer.data(), srcBuffer.size());
       if (written < 0)
       {
         SetError("Cannot write to hid device");
@@ -711,7 +788,7 @@ public:
 
 private:
   int written = 0;
-  std::vector<unsigned char> srcBuffer;
+  WriteData srcBuffer;
 };
 
 Napi::Value HIDAsync::write(const Napi::CallbackInfo &info)
@@ -730,8 +807,8 @@ Napi::Value HIDAsync::write(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
-  std::vector<unsigned char> message;
-  std::string copyError = copyArrayOrBufferIntoVector(info[0], message);
+  WriteData message;
+  std::string copyError = message.assign(info[0]);
   if (copyError != "")
   {
     Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
@@ -741,23 +818,29 @@ Napi::Value HIDAsync::write(const Napi::CallbackInfo &info)
   return (new WriteWorker(env, _hidHandle, std::move(message)))->QueueAndRun();
 }
 
-class GetDeviceInfoWorker : public PromiseAsyncWorker<std::shared_ptr<DeviceContext>>
+class WriteManyWorker : public PromiseAsyncWorker<std::shared_ptr<DeviceContext>>
 {
 public:
-  GetDeviceInfoWorker(
+  WriteManyWorker(
       Napi::Env &env,
-      std::shared_ptr<DeviceContext> hid)
-      : PromiseAsyncWorker(env, hid) {}
+      std::shared_ptr<DeviceContext> hid,
+      std::vector<unsigned char> data,
+      std::vector<size_t> offsets)
+      : PromiseAsyncWorker(env, hid),
+        data(std::move(data)),
+        offsets(std::move(offsets)) {}
 
   // This code will be executed on the worker thread. Note: Napi types cannot be used
   void Execute() override
   {
     if (context->hid)
     {
-      dev = hid_get_device_info(context->hid);
-      if (!dev)
+      written.reserve(offsets.size() - 1);
+      context->writeMany(data.data(), offsets, written);
+      if (!written.empty() && written.back() < 0)
       {
-        SetError("Unable to get device info");
+        SetError("Cannot write report " + std::to_string(written.size() - 1) + " to hid device");
+        return;
       }
     }
     else
@@ -768,22 +851,128 @@ public:
 
   Napi::Value GetPromiseResult(const Napi::Env &env) override
   {
-    // if the hid device has somehow been deleted, the hid_device_info is no longer valid
+    Napi::Array result = Napi::Array::New(env, written.size());
+    for (size_t i = 0; i < written.size(); i++)
+    {
+      result.Set(i, Napi::Number::New(env, written[i]));
+    }
+    return result;
+  }
+
+private:
+  std::vector<unsigned char> data;
+  std::vector<size_t> offsets;
+  std::vector<int> written;
+};
+
+Napi::Value HIDAsync::writeMany(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle || _hidHandle->is_closed)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::vector<unsigned char> data;
+  std::vector<size_t> offsets;
+  std::string copyError = copyReportsIntoVector(info, data, offsets);
+  if (copyError != "")
+  {
+    Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return (new WriteManyWorker(env, _hidHandle, std::move(data), std::move(offsets)))->QueueAndRun();
+}
+
+/**
+ * Writes the newest payload given to writeLatest for a key.
+ * Until the lane starts this job, a newer payload replaces the current one, whose promise resolves with "coalesced" instead of queueing another job
+ */
+class LatestWriteWorker : public Napi::AsyncWorker
+{
+public:
+  LatestWriteWorker(
+      Napi::Env &env,
+      std::shared_ptr<DeviceContext> hid,
+      uint32_t key,
+      std::vector<unsigned char> data,
+      Napi::Promise::Deferred deferred,
+      Napi::Error errorResult)
+      : Napi::AsyncWorker(env),
+        context(hid),
+        key(key),
+        data(std::move(data)),
+        deferred(deferred),
+        errorResult(std::move(errorResult)) {}
+
+  /**
+   * Replace the payload and the caller waiting for it, returning the promise of the old one.
+   * Note: This must only be run from the main thread, with coalesceLock held, so that the lane hasn't started the job
+   */
+  Napi::Promise::Deferred Supersede(std::vector<unsigned char> newData, Napi::Promise::Deferred newDeferred, Napi::Error newErrorResult)
+  {
+    data = std::move(newData);
+    errorResult = std::move(newErrorResult);
+    std::swap(deferred, newDeferred);
+    return newDeferred;
+  }
+
+  // This code will be executed on the worker thread. Note: Napi types cannot be used
+  void Execute() override
+  {
+    {
+      // Once taken, the payload can no longer be replaced, so a newer one will queue another job
+      std::unique_lock<std::mutex> lock(context->coalesceLock);
+      auto it = context->coalescing.find(key);
+      if (it != context->coalescing.end() && it->second == this)
+      {
+        context->coalescing.erase(it);
+      }
+    }
+
     if (context->hid)
     {
-      return generateDeviceInfo(env, dev);
+      written = context->write(data.data(), data.size());
+      if (written < 0)
+      {
+        SetError("Cannot write to hid device");
+      }
     }
     else
     {
-      return env.Null();
+      SetError("device has been closed");
     }
   }
 
+  void OnOK() override
+  {
+    Napi::Env env = Env();
+    context->JobFinished(env);
+    deferred.Resolve(Napi::Number::New(env, written));
+  }
+  void OnError(Napi::Error const &error) override
+  {
+    // Keep the stack of the caller, with the actual error as the message
+    errorResult.Value().Set("message", error.Message());
+
+    context->JobFinished(Env());
+    deferred.Reject(errorResult.Value());
+  }
+
 private:
-  // this is owned by context->hid
-  hid_device_info *dev;
+  std::shared_ptr<DeviceContext> context;
+  uint32_t key;
+  std::vector<unsigned char> data;
+  Napi::Promise::Deferred deferred;
+  // Created by the call which is waiting, to store its stack trace
+  Napi::Error errorResult;
+  int written = 0;
 };
-Napi::Value HIDAsync::getDeviceInfo(const Napi::CallbackInfo &info)
+
+Napi::Value HIDAsync::writeLatest(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
 
@@ -793,7 +982,764 @@ Napi::Value HIDAsync::getDeviceInfo(const Napi::CallbackInfo &info)
     return env.Null();
   }
 
-  return (new GetDeviceInfoWorker(env, _hidHandle))->QueueAndRun();
+  if (info.Length() < 1)
+  {
+    Napi::TypeError::New(env, "HID writeLatest requires a report").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // The payload is copied, so the caller can reuse its buffer for the next frame straight away
+  std::vector<unsigned char> data;
+  std::string copyError = copyArrayOrBufferIntoVector(info[0], data);
+  if (copyError != "")
+  {
+    Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (data.empty())
+  {
+    Napi::TypeError::New(env, "HID writeLatest requires a non-empty report").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // By default, writes with the same report id replace each other
+  uint32_t key = data[0];
+  if (info.Length() > 1 && !info[1].IsUndefined() && !info[1].IsNull())
+  {
+    if (!info[1].IsNumber())
+    {
+      Napi::TypeError::New(env, "writeLatest key must be a number").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    key = info[1].As<Napi::Number>().Uint32Value();
+  }
+
+  auto deferred = Napi::Promise::Deferred::New(env);
+  // Create an error now, to store the stack trace
+  auto errorResult = Napi::Error::New(env, "Unknown error");
+
+  LatestWriteWorker *worker = nullptr;
+  Napi::Promise::Deferred superseded = deferred;
+  {
+    std::unique_lock<std::mutex> lock(_hidHandle->coalesceLock);
+    auto it = _hidHandle->coalescing.find(key);
+    if (it != _hidHandle->coalescing.end())
+    {
+      superseded = it->second->Supersede(std::move(data), deferred, std::move(errorResult));
+    }
+    else
+    {
+      worker = new LatestWriteWorker(env, _hidHandle, key, std::move(data), deferred, std::move(errorResult));
+      _hidHandle->coalescing[key] = worker;
+    }
+  }
+
+  if (worker)
+  {
+    _hidHandle->QueueJob(env, worker);
+  }
+  else
+  {
+    _hidHandle->stats.add(STAT_WRITES_COALESCED);
+    superseded.Resolve(Napi::String::New(env, "coalesced"));
+  }
+
+  return deferred.Promise();
+}
+
+Napi::Value HIDAsync::sendMessage(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle || _hidHandle->is_closed)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 3 || !info[1].IsNumber())
+  {
+    Napi::TypeError::New(env, "need framer, command and payload in sendMessage").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  FramerConfig config;
+  std::string framerError = parseFramerConfig(info[0], config);
+  if (framerError != "")
+  {
+    Napi::TypeError::New(env, framerError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t command = info[1].As<Napi::Number>().Int32Value();
+  if (command < 0 || command > 127)
+  {
+    Napi::TypeError::New(env, "message command must be from 0 to 127").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::vector<unsigned char> payload;
+  std::string copyError = copyArrayOrBufferIntoVector(info[2], payload);
+  if (copyError != "")
+  {
+    Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::vector<unsigned char> data;
+  std::vector<size_t> offsets;
+  std::string segmentError = segmentMessage(config, (unsigned char)command, payload.data(), payload.size(), data, offsets);
+  if (segmentError != "")
+  {
+    Napi::TypeError::New(env, segmentError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // Every packet is written by the one job, so packets of other writes can't be interleaved with them
+  return (new WriteManyWorker(env, _hidHandle, std::move(data), std::move(offsets)))->QueueAndRun();
+}
+
+Napi::Value HIDAsync::startSchedule(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle || _hidHandle->is_closed)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (scheduler)
+  {
+    Napi::TypeError::New(env, "a schedule is already running").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() != 3 || !info[1].IsNumber() || !info[2].IsNumber())
+  {
+    Napi::TypeError::New(env, "need frames, frameSize and rate in startSchedule").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  unsigned char *frames = nullptr;
+  size_t length = 0;
+  std::string bufferError = getTargetBuffer(info[0], frames, length);
+  if (bufferError != "")
+  {
+    Napi::TypeError::New(env, "schedule frames must be a non-empty Buffer or Uint8Array").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int64_t frameSize = info[1].As<Napi::Number>().Int64Value();
+  if (frameSize < 1 || length % frameSize != 0)
+  {
+    Napi::TypeError::New(env, "schedule frameSize must divide the length of the frames").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  double rate = info[2].As<Napi::Number>().DoubleValue();
+  if (!(rate > 0 && rate <= 10000))
+  {
+    Napi::TypeError::New(env, "schedule rate must be from 0 to 10000 per second").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // Keep the frames alive for as long as the scheduler may read them
+  scheduleFrames = std::make_shared<Napi::ObjectReference>(Napi::Persistent(info[0].As<Napi::Object>()));
+  scheduler = std::make_shared<OutputScheduler>(_hidHandle, frames, frameSize, length / frameSize, (uint64_t)(1e9 / rate));
+
+  return env.Null();
+}
+
+class StopScheduleWorker : public PromiseAsyncWorker<std::shared_ptr<DeviceContext>>
+{
+public:
+  StopScheduleWorker(
+      Napi::Env &env,
+      std::shared_ptr<DeviceContext> hid,
+      std::shared_ptr<OutputScheduler> scheduler,
+      std::shared_ptr<Napi::ObjectReference> scheduleFrames)
+      : PromiseAsyncWorker(env, hid),
+        scheduler(std::move(scheduler)),
+        scheduleFrames(std::move(scheduleFrames)) {}
+
+  // This code will be executed on the worker thread. Note: Napi types cannot be used
+  void Execute() override
+  {
+    // The frames are released along with this job, once the scheduler has finished with them
+    scheduler->wait();
+    scheduler = nullptr;
+  }
+
+  Napi::Value GetPromiseResult(const Napi::Env &env) override
+  {
+    return env.Undefined();
+  }
+
+private:
+  std::shared_ptr<OutputScheduler> scheduler;
+  std::shared_ptr<Napi::ObjectReference> scheduleFrames;
+};
+
+Napi::Value HIDAsync::stopSchedule(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!scheduler)
+  {
+    return env.Null();
+  }
+
+  // Stop straight away, so that a new schedule can be started before this one has been waited for
+  scheduler->stop();
+
+  auto result = (new StopScheduleWorker(env, _hidHandle, std::move(scheduler), std::move(scheduleFrames)))->QueueAndRun();
+
+  scheduler = nullptr;
+  scheduleFrames = nullptr;
+
+  return result;
+}
+
+// The longest interval for pollFeatureReport, a day
+#define FEATURE_POLL_MAX_INTERVAL_MS 86400000
+
+struct FeatureChange
+{
+  std::vector<unsigned char> report;
+  uint64_t receivedAt;
+  bool failed;
+};
+
+static void FeatureChangeCallback(Napi::Env env, Napi::Function jsCallback, FeaturePoll *, FeatureChange *change)
+{
+  if (env != nullptr && jsCallback != nullptr)
+  {
+    if (change->failed)
+    {
+      jsCallback.Call({Napi::Error::New(env, "could not get feature report from device").Value()});
+    }
+    else
+    {
+      jsCallback.Call({env.Null(), Napi::Buffer<unsigned char>::Copy(env, change->report.data(), change->report.size()), Napi::Number::New(env, (double)change->receivedAt)});
+    }
+  }
+
+  delete change;
+}
+
+using FeaturePollTSFN = Napi::TypedThreadSafeFunction<FeaturePoll, FeatureChange, FeatureChangeCallback>;
+
+/**
+ * Polls a feature report on the lane of the device, passing it to javascript only when it has changed
+ */
+class FeaturePoll : public LaneTask
+{
+public:
+  FeaturePoll(DeviceContext *context, uint8_t reportId, size_t length, uint64_t intervalNs)
+      : LaneTask(intervalNs), context(context), reportId(reportId), buffer(length) {}
+
+  ~FeaturePoll()
+  {
+    tsfn.Release();
+  }
+
+  bool Run() override
+  {
+    if (!context->hid)
+    {
+      return false;
+    }
+
+    buffer[0] = reportId;
+    uint64_t startedAt = monotonicNow();
+    int length = hid_get_feature_report(context->hid, buffer.data(), buffer.size());
+    context->stats.countFeature(length, startedAt);
+    if (length < 0)
+    {
+      auto change = new FeatureChange{{}, 0, true};
+      if (tsfn.NonBlockingCall(change) != napi_ok)
+      {
+        delete change;
+      }
+      return false;
+    }
+
+    if (seen && previous.size() == (size_t)length && std::equal(previous.begin(), previous.end(), buffer.begin()))
+    {
+      context->stats.add(STAT_FEATURE_UNCHANGED);
+      return true;
+    }
+
+    previous.assign(buffer.begin(), buffer.begin() + length);
+    seen = true;
+
+    auto change = new FeatureChange{previous, startedAt, false};
+    if (tsfn.NonBlockingCall(change) != napi_ok)
+    {
+      delete change;
+    }
+    return true;
+  }
+
+  FeaturePollTSFN tsfn;
+
+private:
+  // The lane is part of the context, and RemoveTask waits for a running poll to return, so the context outlives any use of it here
+  DeviceContext *context;
+  uint8_t reportId;
+  std::vector<unsigned char> buffer;
+
+  // The last report passed to javascript
+  bool seen = false;
+  std::vector<unsigned char> previous;
+};
+
+Napi::Value HIDAsync::pollFeatureReport(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle || _hidHandle->is_closed)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() != 4 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber() || !info[3].IsFunction())
+  {
+    Napi::TypeError::New(env, "need report ID, length, interval and callback in pollFeatureReport").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t reportId = info[0].As<Napi::Number>().Int32Value();
+  if (reportId < 0 || reportId > 255)
+  {
+    Napi::TypeError::New(env, "report ID must be from 0 to 255").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int32_t length = info[1].As<Napi::Number>().Int32Value();
+  if (length < 1 || length > READ_BUFF_MAXSIZE)
+  {
+    Napi::TypeError::New(env, "poll length must be from 1 to " + std::to_string(READ_BUFF_MAXSIZE)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // The upper limit keeps the interval in nanoseconds from overflowing
+  double interval = info[2].As<Napi::Number>().DoubleValue();
+  if (!(interval >= 1 && interval <= FEATURE_POLL_MAX_INTERVAL_MS))
+  {
+    Napi::TypeError::New(env, "poll interval must be from 1 to " + std::to_string(FEATURE_POLL_MAX_INTERVAL_MS) + " milliseconds").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto poll = std::make_shared<FeaturePoll>(_hidHandle.get(), (uint8_t)reportId, length, (uint64_t)(interval * 1000000));
+  poll->tsfn = FeaturePollTSFN::New(
+      env,
+      info[3].As<Napi::Function>(),
+      "HID:featurePoll",
+      0,
+      1,
+      poll.get(),
+      // The poll owns the tsfn, so there is nothing to clean up
+      [](Napi::Env, FeaturePoll *) {});
+  // Like the lane, a poll doesn't keep the process alive by itself
+  poll->tsfn.Unref(env);
+
+  // A new poll of the same report replaces the old one
+  auto existing = featurePolls.find(reportId);
+  if (existing != featurePolls.end())
+  {
+    _hidHandle->RemoveTask(existing->second);
+  }
+  featurePolls[reportId] = poll;
+
+  _hidHandle->AddTask(poll);
+
+  return env.Null();
+}
+
+Napi::Value HIDAsync::stopFeaturePoll(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || info[0].IsUndefined())
+  {
+    stopFeaturePolls();
+    return env.Null();
+  }
+
+  if (!info[0].IsNumber())
+  {
+    Napi::TypeError::New(env, "need report ID in stopFeaturePoll").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto existing = featurePolls.find((uint8_t)info[0].As<Napi::Number>().Int32Value());
+  if (existing != featurePolls.end())
+  {
+    if (_hidHandle)
+    {
+      _hidHandle->RemoveTask(existing->second);
+    }
+    featurePolls.erase(existing);
+  }
+
+  return env.Null();
+}
+
+void HIDAsync::stopFeaturePolls()
+{
+  if (_hidHandle)
+  {
+    for (auto &poll : featurePolls)
+    {
+      _hidHandle->RemoveTask(poll.second);
+    }
+  }
+  featurePolls.clear();
+}
+
+class GetDeviceInfoWorker : public PromiseAsyncWorker<std::shared_ptr<DeviceContext>>
+{
+public:
+  GetDeviceInfoWorker(
+      Napi::Env &env,
+      std::shared_ptr<DeviceContext> hid)
+      : PromiseAsyncWorker(env, hid) {}
+
+  // This code will be executed on the worker thread. Note: Napi types cannot be used
+  void Execute() override
+  {
+    if (context->hid)
+    {
+      dev = hid_get_device_info(context->hid);
+      if (!dev)
+      {
+        SetError("Unable to get device info");
+      }
+    }
+    else
+    {
+      SetError("device has been closed");
+    }
+  }
+
+  Napi::Value GetPromiseResult(const Napi::Env &env) override
+  {
+    // if the hid device has somehow been deleted, the hid_device_info is no longer valid
+    if (context->hid)
+    {
+      return generateDeviceInfo(env, dev);
+    }
+    else
+    {
+      return env.Null();
+    }
+  }
+
+private:
+  // this is owned by context->hid
+  hid_device_info *dev;
+};
+Napi::Value HIDAsync::getDeviceInfo(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle || _hidHandle->is_closed)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return (new GetDeviceInfoWorker(env, _hidHandle))->QueueAndRun();
+}
+
+class GetReportDescriptorWorker : public PromiseAsyncWorker<std::shared_ptr<DeviceContext>>
+{
+public:
+  GetReportDescriptorWorker(
+      Napi::Env &env,
+      std::shared_ptr<DeviceContext> hid,
+      bool parse)
+      : PromiseAsyncWorker(env, hid),
+        parse(parse) {}
+
+  // This code will be executed on the worker thread. Note: Napi types cannot be used
+  void Execute() override
+  {
+    if (context->hid)
+    {
+      std::string error = getReportDescriptor(context->hid, descriptor);
+      if (error == "" && parse)
+      {
+        error = parseReportDescriptor(descriptor.data(), descriptor.size(), parsed);
+      }
+      if (error != "")
+      {
+        SetError(error);
+      }
+    }
+    else
+    {
+      SetError("device has been closed");
+    }
+  }
+
+  Napi::Value GetPromiseResult(const Napi::Env &env) override
+  {
+    if (parse)
+    {
+      return generateReportFields(env, parsed);
+    }
+    return Napi::Buffer<unsigned char>::Copy(env, descriptor.data(), descriptor.size());
+  }
+
+private:
+  bool parse;
+  std::vector<unsigned char> descriptor;
+  ReportDescriptor parsed;
+};
+
+Napi::Value HIDAsync::getReportDescriptor(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle || _hidHandle->is_closed)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return (new GetReportDescriptorWorker(env, _hidHandle, false))->QueueAndRun();
+}
+
+Napi::Value HIDAsync::getReportFields(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle || _hidHandle->is_closed)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return (new GetReportDescriptorWorker(env, _hidHandle, true))->QueueAndRun();
+}
+
+Napi::Value HIDAsync::getStats(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  StatsSnapshot stats;
+  _hidHandle->stats.addTo(stats);
+  return generateStatsObject(env, stats);
+}
+
+/**
+ * Writes the request of a transaction. The reply is collected by the read, so this only has to report a failed write
+ */
+class TransactWriteWorker : public Napi::AsyncWorker
+{
+public:
+  TransactWriteWorker(
+      Napi::Env &env,
+      std::shared_ptr<DeviceContext> hid,
+      std::shared_ptr<ReadThreadState> read_state,
+      uint32_t id,
+      WriteData &&srcBuffer)
+      : Napi::AsyncWorker(env),
+        context(hid),
+        read_state(std::move(read_state)),
+        id(id),
+        srcBuffer(std::move(srcBuffer)) {}
+
+  // This code will be executed on the worker thread. Note: Napi types cannot be used
+  void Execute() override
+  {
+    if (context->hid)
+    {
+      int written = context->write(srcBuffer.data(), srcBuffer.size());
+      if (written < 0)
+      {
+        SetError("Cannot write to hid device");
+      }
+    }
+    else
+    {
+      SetError("device has been closed");
+    }
+  }
+
+  void OnOK() override
+  {
+    context->JobFinished(Env());
+  }
+  void OnError(Napi::Error const &error) override
+  {
+    context->JobFinished(Env());
+    read_state->transactions.reject(id, error.Message());
+  }
+
+private:
+  std::shared_ptr<DeviceContext> context;
+  std::shared_ptr<ReadThreadState> read_state;
+  uint32_t id;
+  WriteData srcBuffer;
+};
+
+Napi::Value HIDAsync::transact(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle || _hidHandle->is_closed)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // The reply is found by the read, so one must be running
+  if (!read_state || !read_state->is_running())
+  {
+    Napi::TypeError::New(env, "transact needs the device to be reading").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() != 4 || !info[0].IsNumber() || !info[2].IsNumber())
+  {
+    Napi::TypeError::New(env, "need id, request, match offset and match bytes in transact").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  uint32_t id = info[0].As<Napi::Number>().Uint32Value();
+  int offset = info[2].As<Napi::Number>().Int32Value();
+  if (id == 0 || offset < 0)
+  {
+    Napi::TypeError::New(env, "transact id must be positive, and match offset non-negative").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  WriteData request;
+  std::string copyError = request.assign(info[1]);
+  if (copyError != "")
+  {
+    Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::vector<unsigned char> expected;
+  copyError = copyArrayOrBufferIntoVector(info[3], expected);
+  if (copyError != "")
+  {
+    Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // Look for the reply before writing, and don't write until reports are being read, so that it can't be missed
+  auto deferred = Napi::Promise::Deferred::New(env);
+  read_state->transactions.add(id, offset, std::move(expected), deferred);
+
+  auto job = new TransactWriteWorker(env, _hidHandle, read_state, id, std::move(request));
+  if (read_state->ready)
+  {
+    _hidHandle->QueueJob(env, job);
+  }
+  else
+  {
+    read_state->afterReady.push_back(job);
+  }
+
+  return deferred.Promise();
+}
+
+Napi::Value HIDAsync::cancelTransaction(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (info.Length() < 1 || !info[0].IsNumber())
+  {
+    Napi::TypeError::New(env, "need id in cancelTransaction").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::string message = "transaction timed out";
+  if (info.Length() > 1 && info[1].IsString())
+  {
+    message = info[1].As<Napi::String>().Utf8Value();
+  }
+
+  // Once the read has stopped, its transactions have already been rejected
+  if (read_state)
+  {
+    read_state->transactions.reject(info[0].As<Napi::Number>().Uint32Value(), message);
+  }
+
+  return env.Null();
+}
+
+Napi::Value HIDAsync::getLatestReport(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+
+  if (!_hidHandle)
+  {
+    Napi::TypeError::New(env, "device has been closed").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsTypedArray())
+  {
+    Napi::TypeError::New(env, "need report id and target Uint8Array in getLatestReport").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  int reportId = info[0].As<Napi::Number>().Int32Value();
+  if (reportId < 0 || reportId > 255)
+  {
+    Napi::TypeError::New(env, "report id must be from 0 to 255").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  auto target = info[1].As<Napi::TypedArray>();
+  if (target.TypedArrayType() != napi_uint8_array)
+  {
+    Napi::TypeError::New(env, "target must be a Uint8Array").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // Optionally receives when the report was read and its sequence number, without allocating an object
+  Napi::Float64Array meta;
+  if (info.Length() > 2 && !info[2].IsUndefined())
+  {
+    if (!info[2].IsTypedArray() || info[2].As<Napi::TypedArray>().TypedArrayType() != napi_float64_array || info[2].As<Napi::TypedArray>().ElementLength() < 2)
+    {
+      Napi::TypeError::New(env, "meta must be a Float64Array of at least 2 elements").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    meta = info[2].As<Napi::Float64Array>();
+  }
+
+  uint64_t receivedAt = 0;
+  uint64_t sequence = 0;
+  size_t length = _hidHandle->latest.load((unsigned char)reportId, target.As<Napi::Uint8Array>().Data(), target.ByteLength(), receivedAt, sequence);
+  if (length == 0)
+  {
+    return env.Null();
+  }
+
+  if (!meta.IsEmpty())
+  {
+    meta[0] = (double)receivedAt;
+    meta[1] = (double)sequence;
+  }
+
+  return Napi::Number::New(env, (double)length);
 }
 
 Napi::Function HIDAsync::Initialize(Napi::Env &env)
@@ -802,12 +1748,27 @@ Napi::Function HIDAsync::Initialize(Napi::Env &env)
                                                          InstanceMethod("close", &HIDAsync::close),
                                                          InstanceMethod("readStart", &HIDAsync::readStart),
                                                          InstanceMethod("readStop", &HIDAsync::readStop),
+                                                         InstanceMethod("setReportIds", &HIDAsync::setReportIds),
+                                                         InstanceMethod("getLatestReport", &HIDAsync::getLatestReport),
+                                                         InstanceMethod("transact", &HIDAsync::transact),
+                                                         InstanceMethod("cancelTransaction", &HIDAsync::cancelTransaction),
+                                                         InstanceMethod("sendMessage", &HIDAsync::sendMessage),
+                                                         InstanceMethod("startSchedule", &HIDAsync::startSchedule),
+                                                         InstanceMethod("stopSchedule", &HIDAsync::stopSchedule, napi_enumerable),
+                                                         InstanceMethod("pollFeatureReport", &HIDAsync::pollFeatureReport),
+                                                         InstanceMethod("stopFeaturePoll", &HIDAsync::stopFeaturePoll),
                                                          InstanceMethod("write", &HIDAsync::write, napi_enumerable),
+                                                         InstanceMethod("writeMany", &HIDAsync::writeMany, napi_enumerable),
+                                                         InstanceMethod("writeLatest", &HIDAsync::writeLatest, napi_enumerable),
                                                          InstanceMethod("getFeatureReport", &HIDAsync::getFeatureReport, napi_enumerable),
                                                          InstanceMethod("sendFeatureReport", &HIDAsync::sendFeatureReport, napi_enumerable),
                                                          InstanceMethod("setNonBlocking", &HIDAsync::setNonBlocking, napi_enumerable),
                                                          InstanceMethod("read", &HIDAsync::read, napi_enumerable),
                                                          InstanceMethod("getDeviceInfo", &HIDAsync::getDeviceInfo, napi_enumerable),
+                                                         InstanceMethod("getReportDescriptor", &HIDAsync::getReportDescriptor, napi_enumerable),
+                                                         InstanceMethod("getReportFields", &HIDAsync::getReportFields, napi_enumerable),
+                                                         // This is synchronous, so is not enumerable to keep it out of the async wrappers
+                                                         InstanceMethod("getStats", &HIDAsync::getStats),
                                                      });
 
   return ctor;
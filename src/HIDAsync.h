@@ -1,5 +1,8 @@
 #include "util.h"
 #include "read.h"
+#include "scheduler.h"
+
+class FeaturePoll;
 
 class HIDAsync : public Napi::ObjectWrap<HIDAsync>
 {
@@ -14,16 +17,37 @@ public:
 private:
     std::shared_ptr<DeviceContext> _hidHandle;
     std::shared_ptr<ReadThreadState> read_state;
+    // The running output schedule, and the frames it sends
+    std::shared_ptr<OutputScheduler> scheduler;
+    std::shared_ptr<Napi::ObjectReference> scheduleFrames;
+    // Feature reports being polled by the lane, by report id
+    std::map<uint8_t, std::shared_ptr<FeaturePoll>> featurePolls;
+
+    void stopFeaturePolls();
 
     void closeHandle();
 
     Napi::Value close(const Napi::CallbackInfo &info);
     Napi::Value readStart(const Napi::CallbackInfo &info);
     Napi::Value readStop(const Napi::CallbackInfo &info);
+    Napi::Value setReportIds(const Napi::CallbackInfo &info);
     Napi::Value write(const Napi::CallbackInfo &info);
+    Napi::Value writeMany(const Napi::CallbackInfo &info);
+    Napi::Value writeLatest(const Napi::CallbackInfo &info);
     Napi::Value setNonBlocking(const Napi::CallbackInfo &info);
     Napi::Value getFeatureReport(const Napi::CallbackInfo &info);
     Napi::Value sendFeatureReport(const Napi::CallbackInfo &info);
     Napi::Value read(const Napi::CallbackInfo &info);
     Napi::Value getDeviceInfo(const Napi::CallbackInfo &info);
+    Napi::Value getReportDescriptor(const Napi::CallbackInfo &info);
+    Napi::Value getReportFields(const Napi::CallbackInfo &info);
+    Napi::Value getStats(const Napi::CallbackInfo &info);
+    Napi::Value getLatestReport(const Napi::CallbackInfo &info);
+    Napi::Value transact(const Napi::CallbackInfo &info);
+    Napi::Value cancelTransaction(const Napi::CallbackInfo &info);
+    Napi::Value sendMessage(const Napi::CallbackInfo &info);
+    Napi::Value startSchedule(const Napi::CallbackInfo &info);
+    Napi::Value stopSchedule(const Napi::CallbackInfo &info);
+    Napi::Value pollFeatureReport(const Napi::CallbackInfo &info);
+    Napi::Value stopFeaturePoll(const Napi::CallbackInfo &info);
 };
\ No newline at end of file
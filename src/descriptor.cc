@@ -0,0 +1,340 @@
+#include "descriptor.h"
+
+#include <algorithm>
+
+// Item types, from section 6.2.2.2 of the HID specification
+#define HID_ITEM_TYPE_MAIN 0
+#define HID_ITEM_TYPE_GLOBAL 1
+#define HID_ITEM_TYPE_LOCAL 2
+
+#define HID_MAIN_INPUT 0x8
+#define HID_MAIN_OUTPUT 0x9
+#define HID_MAIN_FEATURE 0xB
+
+#define HID_GLOBAL_USAGE_PAGE 0x0
+#define HID_GLOBAL_LOGICAL_MINIMUM 0x1
+#define HID_GLOBAL_LOGICAL_MAXIMUM 0x2
+#define HID_GLOBAL_PHYSICAL_MINIMUM 0x3
+#define HID_GLOBAL_PHYSICAL_MAXIMUM 0x4
+#define HID_GLOBAL_UNIT_EXPONENT 0x5
+#define HID_GLOBAL_UNIT 0x6
+#define HID_GLOBAL_REPORT_SIZE 0x7
+#define HID_GLOBAL_REPORT_ID 0x8
+#define HID_GLOBAL_REPORT_COUNT 0x9
+#define HID_GLOBAL_PUSH 0xA
+#define HID_GLOBAL_POP 0xB
+
+#define HID_LOCAL_USAGE 0x0
+#define HID_LOCAL_USAGE_MINIMUM 0x1
+#define HID_LOCAL_USAGE_MAXIMUM 0x2
+
+#define HID_LONG_ITEM_PREFIX 0xFE
+
+// Reject descriptors which would produce an absurd number of fields
+#define MAX_REPORT_FIELDS 65536
+
+struct GlobalState
+{
+    unsigned int usagePage = 0;
+    int32_t logicalMinimum = 0;
+    int32_t logicalMaximum = 0;
+    // The logical maximum without sign extension
+    uint32_t logicalMaximumUnsigned = 0;
+    int32_t physicalMinimum = 0;
+    int32_t physicalMaximum = 0;
+    int unitExponent = 0;
+    unsigned int unit = 0;
+    unsigned int reportSize = 0;
+    unsigned int reportCount = 0;
+    unsigned int reportId = 0;
+};
+
+// A usage, with its page in the upper 16 bits
+typedef uint32_t ExtendedUsage;
+
+struct LocalState
+{
+    std::vector<ExtendedUsage> usages;
+    bool haveMinimum = false;
+    ExtendedUsage usageMinimum = 0;
+};
+
+static int32_t signExtend(unsigned int value, size_t size)
+{
+    switch (size)
+    {
+    case 1:
+        return (int8_t)value;
+    case 2:
+        return (int16_t)value;
+    default:
+        return (int32_t)value;
+    }
+}
+
+static ExtendedUsage extendUsage(const GlobalState &global, unsigned int value, size_t size)
+{
+    // A four byte usage includes its own usage page
+    return size == 4 ? value : (global.usagePage << 16) | value;
+}
+
+std::string parseReportDescriptor(const unsigned char *descriptor, size_t length, ReportDescriptor &result)
+{
+    GlobalState global;
+    std::vector<GlobalState> stack;
+    LocalState local;
+
+    result = ReportDescriptor();
+
+    size_t i = 0;
+    while (i < length)
+    {
+        unsigned char prefix = descriptor[i++];
+
+        if (prefix == HID_LONG_ITEM_PREFIX)
+        {
+            // Long items carry no data we care about, so skip over them
+            if (i + 2 > length)
+                return "report descriptor is truncated";
+            i += 2 + descriptor[i];
+            continue;
+        }
+
+        size_t size = prefix & 0x3;
+        if (size == 3)
+            size = 4;
+        unsigned int type = (prefix >> 2) & 0x3;
+        unsigned int tag = prefix >> 4;
+
+        if (i + size > length)
+            return "report descriptor is truncated";
+
+        unsigned int value = 0;
+        for (size_t b = 0; b < size; b++)
+        {
+            value |= (unsigned int)descriptor[i + b] << (8 * b);
+        }
+        i += size;
+
+        if (type == HID_ITEM_TYPE_MAIN)
+        {
+            ReportType reportType;
+            if (tag == HID_MAIN_INPUT)
+                reportType = REPORT_TYPE_INPUT;
+            else if (tag == HID_MAIN_OUTPUT)
+                reportType = REPORT_TYPE_OUTPUT;
+            else if (tag == HID_MAIN_FEATURE)
+                reportType = REPORT_TYPE_FEATURE;
+            else
+            {
+                // Collections only group usages, which isn't needed for decoding
+                local = LocalState();
+                continue;
+            }
+
+            size_t &bits = result.reportBits[std::make_pair(reportType, global.reportId)];
+
+            if (!(value & HID_FIELD_CONSTANT))
+            {
+                if (result.fields.size() + global.reportCount > MAX_REPORT_FIELDS)
+                    return "report descriptor has too many fields";
+
+                // When the minimum is positive, the maximum may have been stored without a sign bit
+                int32_t logicalMaximum = global.logicalMaximum;
+                if (global.logicalMinimum >= 0 && logicalMaximum < 0)
+                {
+                    logicalMaximum = (int32_t)std::min<uint32_t>(global.logicalMaximumUnsigned, 0x7FFFFFFF);
+                }
+
+                for (unsigned int n = 0; n < global.reportCount; n++)
+                {
+                    ExtendedUsage usage = 0;
+                    if (!local.usages.empty())
+                    {
+                        // Array fields all share the usage range, while the last usage repeats for any extra variables
+                        usage = (value & HID_FIELD_VARIABLE) ? local.usages[std::min<size_t>(n, local.usages.size() - 1)] : local.usages[0];
+                    }
+
+                    ReportField field;
+                    field.type = reportType;
+                    field.reportId = global.reportId;
+                    field.usagePage = usage ? usage >> 16 : global.usagePage;
+                    field.usage = usage & 0xFFFF;
+                    field.bitOffset = (global.reportId != 0 ? 8 : 0) + bits + (size_t)n * global.reportSize;
+                    field.bitSize = global.reportSize;
+                    field.logicalMinimum = global.logicalMinimum;
+                    field.logicalMaximum = logicalMaximum;
+                    field.physicalMinimum = global.physicalMinimum;
+                    field.physicalMaximum = global.physicalMaximum;
+                    field.unitExponent = global.unitExponent;
+                    field.unit = global.unit;
+                    field.flags = value;
+                    result.fields.push_back(field);
+                }
+            }
+
+            bits += (size_t)global.reportSize * global.reportCount;
+            local = LocalState();
+        }
+        else if (type == HID_ITEM_TYPE_GLOBAL)
+        {
+            switch (tag)
+            {
+            case HID_GLOBAL_USAGE_PAGE:
+                global.usagePage = value;
+                break;
+            case HID_GLOBAL_LOGICAL_MINIMUM:
+                global.logicalMinimum = signExtend(value, size);
+                break;
+            case HID_GLOBAL_LOGICAL_MAXIMUM:
+                global.logicalMaximum = signExtend(value, size);
+                global.logicalMaximumUnsigned = value;
+                break;
+            case HID_GLOBAL_PHYSICAL_MINIMUM:
+                global.physicalMinimum = signExtend(value, size);
+                break;
+            case HID_GLOBAL_PHYSICAL_MAXIMUM:
+                global.physicalMaximum = signExtend(value, size);
+                break;
+            case HID_GLOBAL_UNIT_EXPONENT:
+                // This is a 4 bit signed value
+                global.unitExponent = (value & 0x8) ? (int)(value & 0xF) - 16 : (int)(value & 0xF);
+                break;
+            case HID_GLOBAL_UNIT:
+                global.unit = value;
+                break;
+            case HID_GLOBAL_REPORT_SIZE:
+                global.reportSize = value;
+                break;
+            case HID_GLOBAL_REPORT_COUNT:
+                global.reportCount = value;
+                break;
+            case HID_GLOBAL_REPORT_ID:
+                if (value == 0 || value > 255)
+                    return "report descriptor has an invalid report id";
+                global.reportId = value;
+                result.numbered = true;
+                break;
+            case HID_GLOBAL_PUSH:
+                stack.push_back(global);
+                break;
+            case HID_GLOBAL_POP:
+                if (stack.empty())
+                    return "report descriptor pops more than it pushes";
+                global = stack.back();
+                stack.pop_back();
+                break;
+            }
+        }
+        else if (type == HID_ITEM_TYPE_LOCAL)
+        {
+            switch (tag)
+            {
+            case HID_LOCAL_USAGE:
+                if (local.usages.size() >= MAX_REPORT_FIELDS)
+                    return "report descriptor has too many usages";
+                local.usages.push_back(extendUsage(global, value, size));
+                break;
+            case HID_LOCAL_USAGE_MINIMUM:
+                local.usageMinimum = extendUsage(global, value, size);
+                local.haveMinimum = true;
+                break;
+            case HID_LOCAL_USAGE_MAXIMUM:
+                if (local.haveMinimum)
+                {
+                    ExtendedUsage usageMaximum = extendUsage(global, value, size);
+                    if (usageMaximum >= local.usageMinimum)
+                    {
+                        // Counted rather than compared against the maximum, which may be the largest possible usage
+                        uint32_t span = usageMaximum - local.usageMinimum;
+                        if (span >= MAX_REPORT_FIELDS - local.usages.size())
+                            return "report descriptor has too many usages";
+                        for (uint32_t n = 0; n <= span; n++)
+                        {
+                            local.usages.push_back(local.usageMinimum + n);
+                        }
+                    }
+                    local.haveMinimum = false;
+                }
+                break;
+            }
+        }
+    }
+
+    return "";
+}
+
+size_t ReportDescriptor::maxInputReportLength() const
+{
+    size_t maxLength = 0;
+    for (auto &it : reportBits)
+    {
+        if (it.first.first != REPORT_TYPE_INPUT)
+            continue;
+
+        size_t bytes = (it.second + 7) / 8;
+        if (it.first.second != 0)
+        {
+            // Numbered reports are prefixed with their id
+            bytes += 1;
+        }
+        if (bytes > maxLength)
+            maxLength = bytes;
+    }
+    return maxLength;
+}
+
+ReportDecoder::ReportDecoder(const ReportDescriptor &descriptor) : numbered(descriptor.numbered)
+{
+    for (auto &field : descriptor.fields)
+    {
+        if (field.type != REPORT_TYPE_INPUT)
+            continue;
+
+        // Only the low 32 bits of larger fields are kept
+        unsigned int bits = field.bitSize > 32 ? 32 : field.bitSize;
+
+        Op op;
+        op.byteOffset = (uint32_t)(field.bitOffset / 8);
+        op.shift = field.bitOffset % 8;
+        op.byteCount = (uint8_t)((op.shift + bits + 7) / 8);
+        op.mask = bits >= 32 ? 0xFFFFFFFF : (1u << bits) - 1;
+        op.signBit = (field.logicalMinimum < 0 && bits > 0 && bits < 32) ? 1u << (bits - 1) : 0;
+        op.index = (uint32_t)count++;
+
+        ops[field.reportId & 0xFF].push_back(op);
+    }
+}
+
+int ReportDecoder::decode(const unsigned char *report, size_t length, int32_t *values) const
+{
+    if (length == 0)
+        return -1;
+
+    unsigned int reportId = numbered ? report[0] : 0;
+    auto &reportOps = ops[reportId];
+    if (reportOps.empty())
+        return -1;
+
+    for (auto &op : reportOps)
+    {
+        if (op.byteOffset + op.byteCount > length)
+            continue;
+
+        uint64_t raw = 0;
+        for (unsigned int b = 0; b < op.byteCount; b++)
+        {
+            raw |= (uint64_t)report[op.byteOffset + b] << (8 * b);
+        }
+
+        uint32_t value = (uint32_t)(raw >> op.shift) & op.mask;
+        if (value & op.signBit)
+        {
+            // Sign extend
+            value |= ~op.mask;
+        }
+        values[op.index] = (int32_t)value;
+    }
+
+    return (int)reportId;
+}
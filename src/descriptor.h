@@ -0,0 +1,117 @@
+#ifndef NODEHID_DESCRIPTOR_H__
+#define NODEHID_DESCRIPTOR_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum ReportType
+{
+    REPORT_TYPE_INPUT,
+    REPORT_TYPE_OUTPUT,
+    REPORT_TYPE_FEATURE,
+};
+
+// Flags of a main item, from section 6.2.2.5 of the HID specification
+#define HID_FIELD_CONSTANT 0x01
+#define HID_FIELD_VARIABLE 0x02
+#define HID_FIELD_RELATIVE 0x04
+
+/**
+ * A single value within a report.
+ * Each value of a main item with a report count above 1 is a separate field
+ */
+struct ReportField
+{
+    ReportType type;
+    unsigned int reportId;
+
+    // For an array field, this is the usage of the first value in the usage range. The value is an index into that range, starting from logicalMinimum
+    unsigned int usagePage;
+    unsigned int usage;
+
+    // Position of the field in the report, including the report id byte of numbered reports
+    size_t bitOffset;
+    unsigned int bitSize;
+
+    int32_t logicalMinimum;
+    int32_t logicalMaximum;
+    int32_t physicalMinimum;
+    int32_t physicalMaximum;
+    int unitExponent;
+    unsigned int unit;
+
+    // HID_FIELD_* flags of the main item
+    unsigned int flags;
+};
+
+/**
+ * The contents of a HID report descriptor.
+ * Constant fields (padding) are not included in fields, but are counted in the length of their report
+ */
+struct ReportDescriptor
+{
+    std::vector<ReportField> fields;
+
+    // Length in bits of each report, by type and report id, excluding the report id byte
+    std::map<std::pair<ReportType, unsigned int>, size_t> reportBits;
+
+    // Whether reports are prefixed with their id
+    bool numbered = false;
+
+    /**
+     * Find the length of the longest INPUT report.
+     * This includes the report id byte when the device uses numbered reports.
+     * Returns 0 if there are no input reports
+     */
+    size_t maxInputReportLength() const;
+};
+
+/**
+ * Parse a HID report descriptor.
+ * Returns a non-empty string upon failure
+ */
+std::string parseReportDescriptor(const unsigned char *descriptor, size_t length, ReportDescriptor &result);
+
+/**
+ * Extracts the values of the INPUT fields from reports, compiled from a report descriptor so that a report needs no further parsing.
+ * Every input field is given an index, in the order they appear in the descriptor, which is where its value is written
+ */
+class ReportDecoder
+{
+public:
+    ReportDecoder(const ReportDescriptor &descriptor);
+
+    // How many values there are, across all reports
+    size_t size() const { return count; }
+
+    /**
+     * Decode the fields of a report into values, leaving those of other reports untouched.
+     * Fields which extend beyond the end of a short report are not written.
+     * Returns the report id, or -1 if the report is not described
+     */
+    int decode(const unsigned char *report, size_t length, int32_t *values) const;
+
+private:
+    struct Op
+    {
+        uint32_t byteOffset;
+        // How many bytes the field spans
+        uint8_t byteCount;
+        uint8_t shift;
+        uint32_t mask;
+        // Set to the sign bit for signed fields, to sign extend them
+        uint32_t signBit;
+        uint32_t index;
+    };
+
+    bool numbered;
+    size_t count = 0;
+    // Ops for each report id
+    std::vector<Op> ops[256];
+};
+
+#endif // NODEHID_DESCRIPTOR_H__
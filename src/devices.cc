@@ -1,4 +1,5 @@
 #include "devices.h"
+#include "hotplug.h"
 
 bool parseDevicesParameters(const Napi::CallbackInfo &info, int *vendorId, int *productId)
 {
@@ -61,6 +62,108 @@ Napi::Value generateDeviceInfo(const Napi::Env &env, hid_device_info *dev)
     return deviceInfo;
 }
 
+Napi::Value generateReportFields(const Napi::Env &env, const ReportDescriptor &descriptor)
+{
+    static const char *typeNames[] = {"input", "output", "feature"};
+
+    Napi::Array retval = Napi::Array::New(env, descriptor.fields.size());
+    uint32_t inputIndex = 0;
+    for (size_t i = 0; i < descriptor.fields.size(); i++)
+    {
+        const ReportField &field = descriptor.fields[i];
+
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("type", Napi::String::New(env, typeNames[field.type]));
+        obj.Set("reportId", Napi::Number::New(env, field.reportId));
+        obj.Set("usagePage", Napi::Number::New(env, field.usagePage));
+        obj.Set("usage", Napi::Number::New(env, field.usage));
+        obj.Set("bitOffset", Napi::Number::New(env, (double)field.bitOffset));
+        obj.Set("bitSize", Napi::Number::New(env, field.bitSize));
+        obj.Set("logicalMinimum", Napi::Number::New(env, field.logicalMinimum));
+        obj.Set("logicalMaximum", Napi::Number::New(env, field.logicalMaximum));
+        obj.Set("physicalMinimum", Napi::Number::New(env, field.physicalMinimum));
+        obj.Set("physicalMaximum", Napi::Number::New(env, field.physicalMaximum));
+        obj.Set("unitExponent", Napi::Number::New(env, field.unitExponent));
+        obj.Set("unit", Napi::Number::New(env, field.unit));
+        obj.Set("isArray", Napi::Boolean::New(env, !(field.flags & HID_FIELD_VARIABLE)));
+        obj.Set("isRelative", Napi::Boolean::New(env, (field.flags & HID_FIELD_RELATIVE) != 0));
+        if (field.type == REPORT_TYPE_INPUT)
+        {
+            // Where the value is written when decoding, matching ReportDecoder
+            obj.Set("index", Napi::Number::New(env, inputIndex++));
+        }
+        retval.Set(i, obj);
+    }
+    return retval;
+}
+
+Napi::Value generateCachedDeviceInfo(const Napi::Env &env, const CachedDevice &dev)
+{
+    Napi::Object deviceInfo = Napi::Object::New(env);
+    deviceInfo.Set("vendorId", Napi::Number::New(env, dev.vendorId));
+    deviceInfo.Set("productId", Napi::Number::New(env, dev.productId));
+    if (dev.hasPath)
+    {
+        deviceInfo.Set("path", Napi::String::New(env, dev.path));
+    }
+    if (dev.hasSerialNumber)
+    {
+        deviceInfo.Set("serialNumber", Napi::String::New(env, dev.serialNumber));
+    }
+    if (dev.hasManufacturer)
+    {
+        deviceInfo.Set("manufacturer", Napi::String::New(env, dev.manufacturer));
+    }
+    if (dev.hasProduct)
+    {
+        deviceInfo.Set("product", Napi::String::New(env, dev.product));
+    }
+    deviceInfo.Set("release", Napi::Number::New(env, dev.release));
+    deviceInfo.Set("interface", Napi::Number::New(env, dev.interface));
+    if (dev.usagePage)
+    {
+        deviceInfo.Set("usagePage", Napi::Number::New(env, dev.usagePage));
+    }
+    if (dev.usage)
+    {
+        deviceInfo.Set("usage", Napi::Number::New(env, dev.usage));
+    }
+    return deviceInfo;
+}
+
+Napi::Value generateCachedDevicesResult(const Napi::Env &env, ContextState *context, const CachedDeviceList &devs)
+{
+    Napi::Array retval = Napi::Array::New(env, devs.size());
+    for (size_t i = 0; i < devs.size(); i++)
+    {
+        auto &entry = context->deviceObjects[std::make_tuple(devs[i]->path, devs[i]->usagePage, devs[i]->usage)];
+        if (!entry.first || !(*entry.first == *devs[i]))
+        {
+            Napi::Object deviceInfo = generateCachedDeviceInfo(env, *devs[i]).As<Napi::Object>();
+
+            // The object is shared by every call which returns this device, so must not be modified
+            Napi::Function freeze = env.Global().Get("Object").As<Napi::Object>().Get("freeze").As<Napi::Function>();
+            freeze.Call({deviceInfo});
+
+            entry.second = Napi::Persistent(deviceInfo);
+        }
+        // Track the latest copy, so that the entry is dropped once the cache no longer references it
+        entry.first = devs[i];
+
+        retval.Set(i, entry.second.Value());
+    }
+
+    for (auto it = context->deviceObjects.begin(); it != context->deviceObjects.end();)
+    {
+        if (it->second.first.use_count() == 1)
+            it = context->deviceObjects.erase(it);
+        else
+            ++it;
+    }
+
+    return retval;
+}
+
 Napi::Value devices(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
@@ -80,6 +183,13 @@ Napi::Value devices(const Napi::CallbackInfo &info)
         return env.Null();
     }
 
+    ContextState *context = (ContextState *)info.Data();
+    if (context && appCtx->enumerationCache.enabled())
+    {
+        auto cached = appCtx->enumerationCache.get(appCtx->enumerateLock, vendorId, productId);
+        return generateCachedDevicesResult(env, context, cached);
+    }
+
     hid_device_info *devs;
     {
         std::unique_lock<std::mutex> lock(appCtx->enumerateLock);
@@ -109,13 +219,25 @@ public:
     // This code will be executed on the worker thread
     void Execute() override
     {
+        auto &cache = context->appCtx->enumerationCache;
+        if (cache.enabled())
+        {
+            useCache = true;
+            cached = cache.get(context->appCtx->enumerateLock, vendorId, productId);
+            return;
+        }
+
         std::unique_lock<std::mutex> lock(context->appCtx->enumerateLock);
         devs = hid_enumerate(vendorId, productId);
     }
 
     Napi::Value GetPromiseResult(const Napi::Env &env) override
     {
-        if (devs)
+        if (useCache)
+        {
+            return generateCachedDevicesResult(env, context, cached);
+        }
+        else if (devs)
         {
             auto result = generateDevicesResultAndFree(env, devs);
             devs = nullptr; // devs has already been freed
@@ -130,7 +252,10 @@ public:
 private:
     int vendorId;
     int productId;
-    hid_device_info *devs;
+    hid_device_info *devs = nullptr;
+
+    bool useCache = false;
+    CachedDeviceList cached;
 };
 
 Napi::Value devicesAsync(const Napi::CallbackInfo &info)
@@ -155,4 +280,175 @@ Napi::Value devicesAsync(const Napi::CallbackInfo &info)
     }
 
     return (new DevicesWorker(env, context, vendorId, productId))->QueueAndRun();
-}
\ No newline at end of file
+}
+Napi::Value setDevicesCache(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    ContextState *context = (ContextState *)info.Data();
+    if (!context)
+    {
+        Napi::TypeError::New(env, "setDevicesCache missing context").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 1 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "setDevicesCache needs a ttl parameter").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    double ttl = info[0].As<Napi::Number>().DoubleValue();
+    if (!(ttl >= 0))
+    {
+        Napi::TypeError::New(env, "setDevicesCache ttl must be 0 or more").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    context->appCtx->enumerationCache.setTtl(ttl);
+    if (ttl == 0)
+    {
+        context->deviceObjects.clear();
+    }
+
+    return env.Null();
+}
+
+#ifdef NODE_HID_HIDRAW
+
+struct HotplugChange
+{
+    CachedDeviceList attached;
+    CachedDeviceList detached;
+    // Set when the monitor has failed
+    std::string error;
+};
+
+static Napi::Array generateChangedDevices(const Napi::Env &env, const CachedDeviceList &devs)
+{
+    Napi::Array retval = Napi::Array::New(env, devs.size());
+    for (size_t i = 0; i < devs.size(); i++)
+    {
+        retval.Set(i, generateCachedDeviceInfo(env, *devs[i]));
+    }
+    return retval;
+}
+
+class WatchSubscriber;
+
+static void HotplugCallback(Napi::Env env, Napi::Function jsCallback, WatchSubscriber *, HotplugChange *change)
+{
+    if (env != nullptr && jsCallback != nullptr)
+    {
+        if (change->error != "")
+        {
+            jsCallback.Call({Napi::Error::New(env, change->error).Value()});
+        }
+        else
+        {
+            jsCallback.Call({env.Null(), generateChangedDevices(env, change->attached), generateChangedDevices(env, change->detached)});
+        }
+    }
+
+    delete change;
+}
+
+using HotplugTSFN = Napi::TypedThreadSafeFunction<WatchSubscriber, HotplugChange, HotplugCallback>;
+
+/**
+ * Forwards changes from the HotplugMonitor to a js callback
+ */
+class WatchSubscriber : public HotplugSubscriber
+{
+public:
+    void OnChange(const CachedDeviceList &attached, const CachedDeviceList &detached) override
+    {
+        auto change = new HotplugChange{attached, detached, ""};
+        if (tsfn.NonBlockingCall(change) != napi_ok)
+        {
+            delete change;
+        }
+    }
+
+    void OnError(const std::string &message) override
+    {
+        auto change = new HotplugChange{{}, {}, message};
+        if (tsfn.NonBlockingCall(change) != napi_ok)
+        {
+            delete change;
+        }
+    }
+
+    std::shared_ptr<ApplicationContext> appCtx;
+    HotplugTSFN tsfn;
+    // Shared with the stop function, which may be called after the finalizer has freed this
+    std::shared_ptr<bool> stopped = std::make_shared<bool>(false);
+};
+
+Napi::Value watchDevices(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    ContextState *context = (ContextState *)info.Data();
+    if (!context)
+    {
+        Napi::TypeError::New(env, "watchDevices missing context").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (info.Length() != 1 || !info[0].IsFunction())
+    {
+        Napi::TypeError::New(env, "need a callback function in watchDevices").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    HotplugMonitor *monitor = context->appCtx->getHotplugMonitor();
+    if (!monitor)
+    {
+        Napi::TypeError::New(env, "watching for devices is not supported").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto subscriber = new WatchSubscriber();
+    subscriber->appCtx = context->appCtx;
+    subscriber->tsfn = HotplugTSFN::New(
+        env,
+        info[0].As<Napi::Function>(),
+        "HID:watch",
+        0,
+        1,
+        subscriber,
+        [](Napi::Env, WatchSubscriber *subscriber)
+        {
+            // Reached after stop, or when the env is being torn down
+            if (!*subscriber->stopped)
+            {
+                *subscriber->stopped = true;
+                subscriber->appCtx->getHotplugMonitor()->Unsubscribe(subscriber);
+            }
+            delete subscriber;
+        });
+
+    std::string subscribeError = monitor->Subscribe(subscriber);
+    if (subscribeError != "")
+    {
+        *subscriber->stopped = true;
+        subscriber->tsfn.Release();
+
+        Napi::TypeError::New(env, subscribeError).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // Return a function to stop watching
+    auto stopped = subscriber->stopped;
+    return Napi::Function::New(env, [subscriber, stopped](const Napi::CallbackInfo &info)
+                               {
+        if (!*stopped)
+        {
+            *stopped = true;
+            subscriber->appCtx->getHotplugMonitor()->Unsubscribe(subscriber);
+            subscriber->tsfn.Release();
+        } });
+}
+
+#endif
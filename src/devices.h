@@ -1,7 +1,18 @@
 #include "util.h"
+#include "descriptor.h"
 
 Napi::Value generateDeviceInfo(const Napi::Env &env, hid_device_info *dev);
 
+Napi::Value generateCachedDeviceInfo(const Napi::Env &env, const CachedDevice &dev);
+
+Napi::Value generateReportFields(const Napi::Env &env, const ReportDescriptor &descriptor);
+
 Napi::Value devices(const Napi::CallbackInfo &info);
 
 Napi::Value devicesAsync(const Napi::CallbackInfo &info);
+
+Napi::Value setDevicesCache(const Napi::CallbackInfo &info);
+
+#ifdef NODE_HID_HIDRAW
+Napi::Value watchDevices(const Napi::CallbackInfo &info);
+#endif
@@ -0,0 +1,163 @@
+#include "enumeration.h"
+#include "util.h"
+
+#include <cmath>
+
+#ifdef NODE_HID_HIDRAW
+#include <libudev.h>
+#include <poll.h>
+#endif
+
+CachedDevice::CachedDevice(const hid_device_info *dev)
+    : vendorId(dev->vendor_id),
+      productId(dev->product_id),
+      release(dev->release_number),
+      interface(dev->interface_number),
+      usagePage(dev->usage_page),
+      usage(dev->usage),
+      hasPath(dev->path != nullptr),
+      hasSerialNumber(dev->serial_number != nullptr),
+      hasManufacturer(dev->manufacturer_string != nullptr),
+      hasProduct(dev->product_string != nullptr)
+{
+    if (hasPath)
+        path = dev->path;
+    if (hasSerialNumber)
+        serialNumber = utf8_encode(dev->serial_number);
+    if (hasManufacturer)
+        manufacturer = utf8_encode(dev->manufacturer_string);
+    if (hasProduct)
+        product = utf8_encode(dev->product_string);
+}
+
+bool CachedDevice::operator==(const CachedDevice &other) const
+{
+    return vendorId == other.vendorId &&
+           productId == other.productId &&
+           release == other.release &&
+           interface == other.interface &&
+           usagePage == other.usagePage &&
+           usage == other.usage &&
+           hasPath == other.hasPath &&
+           hasSerialNumber == other.hasSerialNumber &&
+           hasManufacturer == other.hasManufacturer &&
+           hasProduct == other.hasProduct &&
+           path == other.path &&
+           serialNumber == other.serialNumber &&
+           manufacturer == other.manufacturer &&
+           product == other.product;
+}
+
+EnumerationCache::~EnumerationCache()
+{
+#ifdef NODE_HID_HIDRAW
+    if (monitor)
+        udev_monitor_unref(monitor);
+    if (udev)
+        udev_unref(udev);
+#endif
+}
+
+void EnumerationCache::setTtl(double ttl)
+{
+    std::unique_lock<std::mutex> lk(lock);
+
+    this->ttl = ttl;
+    entries.clear();
+    generation++;
+
+#ifdef NODE_HID_HIDRAW
+    if (ttl > 0 && !monitor)
+    {
+        // If udev is unavailable, the ttl is all there is to go on
+        if (!udev)
+            udev = udev_new();
+        if (udev)
+            monitor = udev_monitor_new_from_netlink(udev, "udev");
+        if (monitor)
+        {
+            udev_monitor_filter_add_match_subsystem_devtype(monitor, "hidraw", nullptr);
+            if (udev_monitor_enable_receiving(monitor) < 0)
+            {
+                udev_monitor_unref(monitor);
+                monitor = nullptr;
+            }
+        }
+    }
+#endif
+}
+
+bool EnumerationCache::enabled()
+{
+    std::unique_lock<std::mutex> lk(lock);
+    return ttl > 0;
+}
+
+void EnumerationCache::invalidate()
+{
+    std::unique_lock<std::mutex> lk(lock);
+    entries.clear();
+    generation++;
+}
+
+void EnumerationCache::checkForChanges()
+{
+#ifdef NODE_HID_HIDRAW
+    if (!monitor)
+        return;
+
+    struct pollfd pfd = {udev_monitor_get_fd(monitor), POLLIN, 0};
+    if (poll(&pfd, 1, 0) <= 0)
+        return;
+
+    // Drain the queued events. Any of them means the results are stale
+    struct udev_device *dev;
+    while ((dev = udev_monitor_receive_device(monitor)) != nullptr)
+    {
+        udev_device_unref(dev);
+    }
+    entries.clear();
+    generation++;
+#endif
+}
+
+CachedDeviceList EnumerationCache::get(std::mutex &enumerateLock, unsigned short vendorId, unsigned short productId)
+{
+    auto key = std::make_pair(vendorId, productId);
+    uint64_t startGeneration;
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        checkForChanges();
+
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            double age = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - it->second.time).count();
+            if (std::isinf(ttl) || age < ttl)
+            {
+                return it->second.devices;
+            }
+        }
+
+        startGeneration = generation;
+    }
+
+    Entry entry;
+    entry.time = std::chrono::steady_clock::now();
+    {
+        std::unique_lock<std::mutex> lk(enumerateLock);
+        hid_device_info *devs = hid_enumerate(vendorId, productId);
+        for (hid_device_info *dev = devs; dev; dev = dev->next)
+        {
+            entry.devices.push_back(std::make_shared<const CachedDevice>(dev));
+        }
+        hid_free_enumeration(devs);
+    }
+
+    std::unique_lock<std::mutex> lk(lock);
+    if (ttl > 0 && generation == startGeneration)
+    {
+        entries[key] = entry;
+    }
+    return entry.devices;
+}
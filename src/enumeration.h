@@ -0,0 +1,93 @@
+#ifndef NODEHID_ENUMERATION_H__
+#define NODEHID_ENUMERATION_H__
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <hidapi.h>
+
+#ifdef NODE_HID_HIDRAW
+struct udev;
+struct udev_monitor;
+#endif
+
+/**
+ * The details of a device from hid_enumerate, with the strings already converted to utf8
+ */
+struct CachedDevice
+{
+    CachedDevice(const hid_device_info *dev);
+
+    bool operator==(const CachedDevice &other) const;
+
+    unsigned short vendorId;
+    unsigned short productId;
+    unsigned short release;
+    int interface;
+    unsigned short usagePage;
+    unsigned short usage;
+
+    // The strings are optional, so track which were provided
+    bool hasPath, hasSerialNumber, hasManufacturer, hasProduct;
+    std::string path;
+    std::string serialNumber;
+    std::string manufacturer;
+    std::string product;
+};
+
+typedef std::vector<std::shared_ptr<const CachedDevice>> CachedDeviceList;
+
+/**
+ * Results of hid_enumerate which can be reused until a device is added or removed.
+ * On linux with hidraw, udev is watched for changes. Elsewhere (or if udev is unavailable) a result is only reused until the ttl expires
+ */
+class EnumerationCache
+{
+public:
+    ~EnumerationCache();
+
+    /**
+     * Set how long a result can be reused for, in milliseconds. Infinity relies on udev alone, and 0 disables the cache
+     */
+    void setTtl(double ttl);
+
+    bool enabled();
+
+    /**
+     * Discard every result, as a device has been added or removed
+     */
+    void invalidate();
+
+    /**
+     * Get the devices matching the filter, calling hid_enumerate if there is no valid result.
+     * enumerateLock is held while enumerating
+     */
+    CachedDeviceList get(std::mutex &enumerateLock, unsigned short vendorId, unsigned short productId);
+
+private:
+    // Check for any change reported by udev. The lock must be held
+    void checkForChanges();
+
+    struct Entry
+    {
+        std::chrono::steady_clock::time_point time;
+        CachedDeviceList devices;
+    };
+
+    std::mutex lock;
+    double ttl = 0;
+    // Incremented whenever the results are discarded, so that an enumeration which raced with that is not stored
+    uint64_t generation = 0;
+    std::map<std::pair<unsigned short, unsigned short>, Entry> entries;
+
+#ifdef NODE_HID_HIDRAW
+    struct udev *udev = nullptr;
+    struct udev_monitor *monitor = nullptr;
+#endif
+};
+
+#endif // NODEHID_ENUMERATION_H__
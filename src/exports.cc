@@ -5,6 +5,11 @@
 #include "HID.h"
 #include "HIDAsync.h"
 #include "devices.h"
+#include "read.h"
+
+#ifdef NODE_HID_MOCK
+#include "mock.h"
+#endif
 
 static void
 deinitialize(void *ptr)
@@ -34,9 +39,20 @@ Init(Napi::Env env, Napi::Object exports)
 
     exports.Set("openAsyncHIDDevice", Napi::Function::New(env, &HIDAsync::Create, nullptr, context)); // TODO: verify context will be alive long enough
 
-    exports.Set("devices", Napi::Function::New(env, &devices));
+    exports.Set("devices", Napi::Function::New(env, &devices, nullptr, context));
     exports.Set("devicesAsync", Napi::Function::New(env, &devicesAsync, nullptr, context)); // TODO: verify context will be alive long enough
 
+#ifdef NODE_HID_HIDRAW
+    exports.Set("watchDevices", Napi::Function::New(env, &watchDevices, nullptr, context));
+#endif
+    exports.Set("setDevicesCache", Napi::Function::New(env, &setDevicesCache, nullptr, context));
+    exports.Set("getStats", Napi::Function::New(env, &getGlobalStats, nullptr, context));
+    exports.Set("setReadReactorThreads", Napi::Function::New(env, &setReadReactorThreads, nullptr, context));
+
+#ifdef NODE_HID_MOCK
+    exports.Set("mock", createMockControl(env));
+#endif
+
     exports.Set("hidapiVersion", Napi::String::New(env, HID_API_VERSION_STR));
 
     return exports;
@@ -0,0 +1,37 @@
+#include "filter.h"
+
+bool ChangeFilter::changed(unsigned char reportId, const unsigned char *report, size_t length)
+{
+    auto &previous = last[reportId];
+
+    bool same = seen[reportId] && previous.size() == length;
+    for (size_t i = 0; same && i < length; i++)
+    {
+        unsigned char byte = i < mask.size() ? report[i] & mask[i] : report[i];
+        same = previous[i] == byte;
+    }
+    if (same)
+    {
+        return false;
+    }
+
+    previous.resize(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        previous[i] = i < mask.size() ? report[i] & mask[i] : report[i];
+    }
+    seen[reportId] = true;
+
+    return true;
+}
+
+bool RateLimiter::allow(unsigned char reportId, uint64_t now)
+{
+    if (now < next[reportId])
+    {
+        return false;
+    }
+
+    next[reportId] = now + intervalNs;
+    return true;
+}
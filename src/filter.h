@@ -0,0 +1,49 @@
+#ifndef NODEHID_FILTER_H__
+#define NODEHID_FILTER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Detects whether a report differs from the previous one with the same report id.
+ * Only the bits set in the mask are compared, so that counters and timestamps within a report can be ignored. Bytes beyond the end of the mask are compared in full
+ */
+class ChangeFilter
+{
+public:
+    ChangeFilter(const std::vector<unsigned char> &mask) : mask(mask) {}
+
+    /**
+     * Check a report against the last one with the same id, remembering it if it has changed.
+     * The first report of each id always counts as a change
+     */
+    bool changed(unsigned char reportId, const unsigned char *report, size_t length);
+
+private:
+    std::vector<unsigned char> mask;
+    // The last report of each id, with the mask applied
+    std::vector<unsigned char> last[256];
+    bool seen[256] = {};
+};
+
+/**
+ * Limits how often reports with each report id may be delivered
+ */
+class RateLimiter
+{
+public:
+    RateLimiter(uint64_t intervalNs) : intervalNs(intervalNs) {}
+
+    // Whether a report with this id may be delivered at now. If so, the next one is held back until the interval has passed
+    bool allow(unsigned char reportId, uint64_t now);
+
+    // When the next report with this id may be delivered
+    uint64_t nextAllowed(unsigned char reportId) const { return next[reportId]; }
+
+private:
+    uint64_t intervalNs;
+    uint64_t next[256] = {};
+};
+
+#endif // NODEHID_FILTER_H__
@@ -0,0 +1,214 @@
+#include "framer.h"
+
+#include <algorithm>
+
+// Sequence numbers of continuation packets run from 0 to this
+#define FRAME_MAX_SEQUENCE 0x7F
+#define FRAME_INIT_FLAG 0x80
+
+size_t FramerConfig::maxMessageLength() const
+{
+    size_t packets = initCapacity() + (size_t)(FRAME_MAX_SEQUENCE + 1) * continuationCapacity();
+    size_t field = lengthSize >= sizeof(size_t) ? SIZE_MAX : ((size_t)1 << (8 * lengthSize)) - 1;
+    return std::min(packets, field);
+}
+
+std::string parseFramerConfig(const Napi::Value &val, FramerConfig &config)
+{
+    if (!val.IsObject())
+    {
+        return "framer must be an object";
+    }
+
+    Napi::Object obj = val.As<Napi::Object>();
+
+    Napi::Value reportSize = obj.Get("reportSize");
+    if (!reportSize.IsUndefined())
+    {
+        if (!reportSize.IsNumber() || reportSize.As<Napi::Number>().Int32Value() < 1 || reportSize.As<Napi::Number>().Int32Value() >= READ_BUFF_MAXSIZE)
+        {
+            return "framer reportSize must be a positive number";
+        }
+        config.reportSize = reportSize.As<Napi::Number>().Int32Value();
+    }
+
+    Napi::Value reportId = obj.Get("reportId");
+    if (!reportId.IsUndefined())
+    {
+        if (!reportId.IsNumber() || reportId.As<Napi::Number>().Int32Value() < 0 || reportId.As<Napi::Number>().Int32Value() > 255)
+        {
+            return "framer reportId must be a number from 0 to 255";
+        }
+        config.reportId = (unsigned char)reportId.As<Napi::Number>().Int32Value();
+    }
+
+    Napi::Value channel = obj.Get("channel");
+    if (!channel.IsUndefined())
+    {
+        if (copyArrayOrBufferIntoVector(channel, config.channel) != "")
+        {
+            return "framer channel must be an array of bytes or a Buffer";
+        }
+    }
+
+    Napi::Value lengthSize = obj.Get("lengthSize");
+    if (!lengthSize.IsUndefined())
+    {
+        if (!lengthSize.IsNumber() || lengthSize.As<Napi::Number>().Int32Value() < 1 || lengthSize.As<Napi::Number>().Int32Value() > 4)
+        {
+            return "framer lengthSize must be from 1 to 4";
+        }
+        config.lengthSize = lengthSize.As<Napi::Number>().Int32Value();
+    }
+
+    Napi::Value littleEndian = obj.Get("littleEndian");
+    if (!littleEndian.IsUndefined())
+    {
+        if (!littleEndian.IsBoolean())
+        {
+            return "framer littleEndian must be a boolean";
+        }
+        config.littleEndian = littleEndian.As<Napi::Boolean>().Value();
+    }
+
+    // Every packet needs room for some data after its header
+    if (config.reportSize <= config.channel.size() + 1 + config.lengthSize)
+    {
+        return "framer reportSize is too small for the channel and length";
+    }
+
+    return "";
+}
+
+std::string segmentMessage(const FramerConfig &config, unsigned char command, const unsigned char *data, size_t length, std::vector<unsigned char> &reports, std::vector<size_t> &offsets)
+{
+    if (length > config.maxMessageLength())
+    {
+        return "message is too long for the framer";
+    }
+
+    size_t continuations = length > config.initCapacity() ? (length - config.initCapacity() + config.continuationCapacity() - 1) / config.continuationCapacity() : 0;
+    size_t stride = 1 + config.reportSize;
+
+    // Padding is left as zeros
+    reports.assign((1 + continuations) * stride, 0);
+    offsets.clear();
+
+    size_t sent = 0;
+    for (size_t i = 0; i <= continuations; i++)
+    {
+        offsets.push_back(i * stride);
+
+        unsigned char *report = reports.data() + i * stride;
+        report[0] = config.reportId;
+
+        unsigned char *packet = report + 1;
+        std::copy(config.channel.begin(), config.channel.end(), packet);
+        packet += config.channel.size();
+
+        size_t capacity;
+        if (i == 0)
+        {
+            *packet++ = command | FRAME_INIT_FLAG;
+            for (size_t b = 0; b < config.lengthSize; b++)
+            {
+                size_t shift = 8 * (config.littleEndian ? b : config.lengthSize - 1 - b);
+                *packet++ = (unsigned char)(length >> shift);
+            }
+            capacity = config.initCapacity();
+        }
+        else
+        {
+            *packet++ = (unsigned char)(i - 1);
+            capacity = config.continuationCapacity();
+        }
+
+        size_t chunk = std::min(capacity, length - sent);
+        std::copy(data + sent, data + sent + chunk, packet);
+        sent += chunk;
+    }
+    offsets.push_back(reports.size());
+
+    return "";
+}
+
+FrameResult Reassembler::feed(const unsigned char *packet, size_t length)
+{
+    size_t channelSize = config.channel.size();
+    if (length < channelSize + 1 || !std::equal(config.channel.begin(), config.channel.end(), packet))
+    {
+        return FRAME_IGNORED;
+    }
+
+    unsigned char type = packet[channelSize];
+    const unsigned char *data = packet + channelSize + 1;
+    size_t available = length - channelSize - 1;
+
+    if (type & FRAME_INIT_FLAG)
+    {
+        if (inProgress)
+        {
+            // A new message abandons any which was incomplete
+            errors++;
+            inProgress = false;
+        }
+
+        size_t messageLength = 0;
+        for (size_t b = 0; b < config.lengthSize && b < available; b++)
+        {
+            size_t shift = 8 * (config.littleEndian ? b : config.lengthSize - 1 - b);
+            messageLength |= (size_t)data[b] << shift;
+        }
+        if (available < config.lengthSize || messageLength > config.maxMessageLength())
+        {
+            errors++;
+            return FRAME_IGNORED;
+        }
+        data += config.lengthSize;
+        available -= config.lengthSize;
+
+        inProgress = true;
+        messageCommand = type & ~FRAME_INIT_FLAG;
+        expectedLength = messageLength;
+        nextSequence = 0;
+        message.clear();
+        message.reserve(messageLength);
+    }
+    else
+    {
+        if (!inProgress)
+        {
+            // The rest of a message whose start was missed
+            return FRAME_IGNORED;
+        }
+        if (type != nextSequence)
+        {
+            errors++;
+            inProgress = false;
+            return FRAME_IGNORED;
+        }
+        nextSequence++;
+    }
+
+    message.insert(message.end(), data, data + std::min(available, expectedLength - message.size()));
+    if (message.size() < expectedLength)
+    {
+        return FRAME_PENDING;
+    }
+
+    inProgress = false;
+    return FRAME_COMPLETE;
+}
+
+std::vector<unsigned char> Reassembler::take()
+{
+    inProgress = false;
+    return std::move(message);
+}
+
+size_t Reassembler::takeErrors()
+{
+    size_t count = errors;
+    errors = 0;
+    return count;
+}
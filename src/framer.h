@@ -0,0 +1,89 @@
+#ifndef NODEHID_FRAMER_H__
+#define NODEHID_FRAMER_H__
+
+#include "util.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Describes how messages are split across reports, in the style of CTAPHID.
+ * The first (init) packet of a message is the channel, the command with its top bit set, then the length of the message and the start of its data.
+ * Each continuation packet is the channel, a sequence number from 0 to 0x7F with the top bit clear, then more of the data.
+ * Packets are padded with zeros to the full report size
+ */
+struct FramerConfig
+{
+    // Length of each packet, excluding the report id
+    size_t reportSize = 64;
+    // Written ahead of each packet
+    unsigned char reportId = 0;
+    // Identifies the messages of this channel at the start of every packet. May be empty
+    std::vector<unsigned char> channel;
+    // Size of the length field of the init packet, from 1 to 4 bytes
+    size_t lengthSize = 2;
+    bool littleEndian = false;
+
+    // How much data fits in each kind of packet
+    size_t initCapacity() const { return reportSize - channel.size() - 1 - lengthSize; }
+    size_t continuationCapacity() const { return reportSize - channel.size() - 1; }
+    // The longest message which can be sent, limited by the sequence numbers and the length field
+    size_t maxMessageLength() const;
+};
+
+/**
+ * Parse the framer option given to readStart or sendMessage.
+ * Returns a non-empty string upon failure
+ */
+std::string parseFramerConfig(const Napi::Value &val, FramerConfig &config);
+
+/**
+ * Split a message into packets, each prefixed with the report id, ready to be written.
+ * command must be from 0 to 127, as the top bit marks the first packet.
+ * offsets receives the start of each report in reports, followed by the total length.
+ * Returns a non-empty string upon failure
+ */
+std::string segmentMessage(const FramerConfig &config, unsigned char command, const unsigned char *data, size_t length, std::vector<unsigned char> &reports, std::vector<size_t> &offsets);
+
+enum FrameResult
+{
+    // The packet is not part of a message on this channel, or was rejected
+    FRAME_IGNORED,
+    // The packet was added to a message which is not yet complete
+    FRAME_PENDING,
+    // A message is complete, and can be taken
+    FRAME_COMPLETE,
+};
+
+/**
+ * Puts messages back together from the packets read from a device
+ */
+class Reassembler
+{
+public:
+    Reassembler(const FramerConfig &config) : config(config) {}
+
+    // Add a packet, without its report id
+    FrameResult feed(const unsigned char *packet, size_t length);
+
+    // Take the message which has just been completed
+    unsigned char command() const { return messageCommand; }
+    std::vector<unsigned char> take();
+
+    // How many messages have been abandoned since this was last called, due to a packet out of sequence, an impossible length, or a new message starting early
+    size_t takeErrors();
+
+private:
+    FramerConfig config;
+
+    bool inProgress = false;
+    unsigned char messageCommand = 0;
+    size_t expectedLength = 0;
+    unsigned char nextSequence = 0;
+    std::vector<unsigned char> message;
+    size_t errors = 0;
+};
+
+#endif // NODEHID_FRAMER_H__
@@ -0,0 +1,631 @@
+/*******************************************************
+ An in-memory implementation of the hidapi interface, with scriptable virtual devices.
+ This allows the node-hid bindings to be exercised and benchmarked without any hardware.
+ ********************************************************/
+
+#include "hidapi_mock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::vector<unsigned char> MockReport;
+typedef std::chrono::steady_clock MockClock;
+
+struct MockDevice
+{
+    std::string path;
+    hid_mock_device_config config;
+
+    // Owned copies of the strings and descriptor referenced by config
+    bool hasSerial, hasManufacturer, hasProduct;
+    std::wstring serial, manufacturer, product;
+    std::vector<unsigned char> descriptor;
+
+    std::mutex lock;
+    std::condition_variable available;
+    std::vector<hid_device *> handles;
+    bool removed = false;
+
+    // Generated reports are produced lazily, based on the time since the device was opened
+    MockClock::time_point start;
+    unsigned long long generated = 0;
+
+    unsigned long long readCalls = 0;
+    unsigned long long writeCalls = 0;
+    std::map<unsigned char, MockReport> features;
+    hid_mock_device_stats stats = {};
+};
+
+struct hid_device_
+{
+    std::shared_ptr<MockDevice> device;
+    std::deque<MockReport> queue;
+    bool nonblocking = false;
+    std::wstring error;
+    hid_device_info *info = nullptr;
+};
+
+static std::mutex registryLock;
+static std::vector<std::shared_ptr<MockDevice>> registry;
+static unsigned int nextDeviceId = 1;
+static thread_local std::wstring globalError;
+
+static char *copyString(const std::string &str)
+{
+    char *res = (char *)malloc(str.size() + 1);
+    memcpy(res, str.c_str(), str.size() + 1);
+    return res;
+}
+
+static wchar_t *copyWideString(const std::wstring &str)
+{
+    wchar_t *res = (wchar_t *)malloc((str.size() + 1) * sizeof(wchar_t));
+    memcpy(res, str.c_str(), (str.size() + 1) * sizeof(wchar_t));
+    return res;
+}
+
+static hid_device_info *makeDeviceInfo(const MockDevice &dev)
+{
+    hid_device_info *info = (hid_device_info *)calloc(1, sizeof(hid_device_info));
+    info->path = copyString(dev.path);
+    info->vendor_id = dev.config.vendor_id;
+    info->product_id = dev.config.product_id;
+    info->serial_number = dev.hasSerial ? copyWideString(dev.serial) : nullptr;
+    info->release_number = dev.config.release_number;
+    info->manufacturer_string = dev.hasManufacturer ? copyWideString(dev.manufacturer) : nullptr;
+    info->product_string = dev.hasProduct ? copyWideString(dev.product) : nullptr;
+    info->usage_page = dev.config.usage_page;
+    info->usage = dev.config.usage;
+    info->interface_number = dev.config.interface_number;
+    info->next = nullptr;
+    info->bus_type = HID_API_BUS_UNKNOWN;
+    return info;
+}
+
+static std::shared_ptr<MockDevice> findDevice(const char *path)
+{
+    std::unique_lock<std::mutex> lk(registryLock);
+    for (auto &dev : registry)
+    {
+        if (path && dev->path == path)
+            return dev;
+    }
+    return nullptr;
+}
+
+// Queue a report on every open handle. The device lock must be held
+static void queueReport(MockDevice &dev, const MockReport &report)
+{
+    for (auto handle : dev.handles)
+    {
+        if (handle->queue.size() >= dev.config.max_queued_reports)
+        {
+            handle->queue.pop_front();
+            dev.stats.reports_dropped++;
+        }
+        handle->queue.push_back(report);
+    }
+    dev.available.notify_all();
+}
+
+// The device lock must be held
+static MockReport makeReport(MockDevice &dev)
+{
+    MockReport report(std::max<size_t>(dev.config.input_report_size, 1));
+    size_t offset = 0;
+    if (dev.config.input_report_id)
+    {
+        report[offset++] = dev.config.input_report_id;
+    }
+
+    unsigned long long seq = dev.generated++;
+    for (int i = 0; i < 4 && offset < report.size(); i++)
+    {
+        report[offset++] = (unsigned char)(seq >> (i * 8));
+    }
+
+    dev.stats.reports_generated++;
+    return report;
+}
+
+// Produce any reports which are due. The device lock must be held
+static void generateDue(MockDevice &dev, MockClock::time_point now)
+{
+    unsigned int rate = dev.config.reports_per_second;
+    if (rate == 0 || rate == HID_MOCK_RATE_UNLIMITED || dev.handles.empty())
+        return;
+
+    unsigned long long elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(now - dev.start).count();
+    unsigned long long due = elapsedUs * rate / 1000000;
+    if (due <= dev.generated)
+        return;
+
+    // Anything beyond what can be queued would be dropped anyway, so skip generating it
+    unsigned long long count = due - dev.generated;
+    if (count > dev.config.max_queued_reports)
+    {
+        unsigned long long skipped = count - dev.config.max_queued_reports;
+        dev.generated += skipped;
+        dev.stats.reports_generated += skipped;
+        dev.stats.reports_dropped += skipped * dev.handles.size();
+        count = dev.config.max_queued_reports;
+    }
+
+    for (unsigned long long i = 0; i < count; i++)
+    {
+        queueReport(dev, makeReport(dev));
+    }
+}
+
+static void injectLatency(unsigned int us)
+{
+    if (us)
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+extern "C"
+{
+
+    void HID_API_EXPORT_CALL hid_mock_default_config(struct hid_mock_device_config *config)
+    {
+        memset(config, 0, sizeof(*config));
+        config->input_report_size = 64;
+        config->max_queued_reports = 1024;
+    }
+
+    const char *HID_API_EXPORT_CALL hid_mock_add_device(const struct hid_mock_device_config *config)
+    {
+        if (!config)
+            return nullptr;
+
+        auto dev = std::make_shared<MockDevice>();
+        dev->config = *config;
+        if (dev->config.max_queued_reports == 0)
+            dev->config.max_queued_reports = 1;
+
+        dev->hasSerial = config->serial_number != nullptr;
+        dev->hasManufacturer = config->manufacturer_string != nullptr;
+        dev->hasProduct = config->product_string != nullptr;
+        if (dev->hasSerial)
+            dev->serial = config->serial_number;
+        if (dev->hasManufacturer)
+            dev->manufacturer = config->manufacturer_string;
+        if (dev->hasProduct)
+            dev->product = config->product_string;
+        if (config->report_descriptor)
+            dev->descriptor.assign(config->report_descriptor, config->report_descriptor + config->report_descriptor_size);
+
+        // Don't keep the caller's pointers
+        dev->config.serial_number = nullptr;
+        dev->config.manufacturer_string = nullptr;
+        dev->config.product_string = nullptr;
+        dev->config.report_descriptor = nullptr;
+
+        std::unique_lock<std::mutex> lk(registryLock);
+        dev->path = "mock:" + std::to_string(nextDeviceId++);
+        registry.push_back(dev);
+        return dev->path.c_str();
+    }
+
+    int HID_API_EXPORT_CALL hid_mock_remove_device(const char *path)
+    {
+        std::shared_ptr<MockDevice> dev;
+        {
+            std::unique_lock<std::mutex> lk(registryLock);
+            for (auto it = registry.begin(); it != registry.end(); ++it)
+            {
+                if (path && (*it)->path == path)
+                {
+                    dev = *it;
+                    registry.erase(it);
+                    break;
+                }
+            }
+        }
+        if (!dev)
+            return -1;
+
+        std::unique_lock<std::mutex> lk(dev->lock);
+        dev->removed = true;
+        dev->available.notify_all();
+        return 0;
+    }
+
+    int HID_API_EXPORT_CALL hid_mock_push_input_report(const char *path, const unsigned char *data, size_t length)
+    {
+        auto dev = findDevice(path);
+        if (!dev)
+            return -1;
+
+        std::unique_lock<std::mutex> lk(dev->lock);
+        queueReport(*dev, MockReport(data, data + length));
+        return 0;
+    }
+
+    int HID_API_EXPORT_CALL hid_mock_get_stats(const char *path, struct hid_mock_device_stats *stats)
+    {
+        auto dev = findDevice(path);
+        if (!dev)
+            return -1;
+
+        std::unique_lock<std::mutex> lk(dev->lock);
+        *stats = dev->stats;
+        return 0;
+    }
+
+    void HID_API_EXPORT_CALL hid_mock_reset(void)
+    {
+        std::vector<std::shared_ptr<MockDevice>> removed;
+        {
+            std::unique_lock<std::mutex> lk(registryLock);
+            removed.swap(registry);
+        }
+
+        for (auto &dev : removed)
+        {
+            std::unique_lock<std::mutex> lk(dev->lock);
+            dev->removed = true;
+            dev->available.notify_all();
+        }
+    }
+
+    int HID_API_EXPORT hid_init(void)
+    {
+        return 0;
+    }
+
+    int HID_API_EXPORT hid_exit(void)
+    {
+        // The virtual devices are left in place, as they are configured independently of hidapi
+        return 0;
+    }
+
+    struct hid_device_info HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+    {
+        std::unique_lock<std::mutex> lk(registryLock);
+
+        hid_device_info *root = nullptr;
+        hid_device_info **next = &root;
+        for (auto &dev : registry)
+        {
+            if ((vendor_id == 0 || dev->config.vendor_id == vendor_id) &&
+                (product_id == 0 || dev->config.product_id == product_id))
+            {
+                *next = makeDeviceInfo(*dev);
+                next = &(*next)->next;
+            }
+        }
+        return root;
+    }
+
+    void HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
+    {
+        while (devs)
+        {
+            hid_device_info *next = devs->next;
+            free(devs->path);
+            free(devs->serial_number);
+            free(devs->manufacturer_string);
+            free(devs->product_string);
+            free(devs);
+            devs = next;
+        }
+    }
+
+    hid_device *HID_API_EXPORT hid_open_path(const char *path)
+    {
+        auto dev = findDevice(path);
+        if (!dev)
+        {
+            globalError = L"no such mock device";
+            return nullptr;
+        }
+
+        hid_device *handle = new hid_device;
+        handle->device = dev;
+
+        std::unique_lock<std::mutex> lk(dev->lock);
+        if (dev->handles.empty())
+        {
+            dev->start = MockClock::now();
+            dev->generated = 0;
+        }
+        dev->handles.push_back(handle);
+        return handle;
+    }
+
+    hid_device *HID_API_EXPORT hid_open(unsigned short vendor_id, unsigned short product_id, const wchar_t *serial_number)
+    {
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lk(registryLock);
+            for (auto &dev : registry)
+            {
+                if (dev->config.vendor_id == vendor_id && dev->config.product_id == product_id &&
+                    (!serial_number || (dev->hasSerial && dev->serial == serial_number)))
+                {
+                    path = dev->path;
+                    break;
+                }
+            }
+        }
+
+        if (path.empty())
+        {
+            globalError = L"no such mock device";
+            return nullptr;
+        }
+        return hid_open_path(path.c_str());
+    }
+
+    void HID_API_EXPORT hid_close(hid_device *handle)
+    {
+        if (!handle)
+            return;
+
+        {
+            auto &dev = *handle->device;
+            std::unique_lock<std::mutex> lk(dev.lock);
+            dev.handles.erase(std::remove(dev.handles.begin(), dev.handles.end(), handle), dev.handles.end());
+        }
+
+        hid_free_enumeration(handle->info);
+        delete handle;
+    }
+
+    int HID_API_EXPORT hid_write(hid_device *handle, const unsigned char *data, size_t length)
+    {
+        if (!handle || !data || length == 0)
+            return -1;
+
+        auto &dev = *handle->device;
+        injectLatency(dev.config.write_latency_us);
+
+        std::unique_lock<std::mutex> lk(dev.lock);
+        if (dev.removed)
+        {
+            handle->error = L"device disconnected";
+            return -1;
+        }
+        if (dev.config.fail_write_every && ++dev.writeCalls % dev.config.fail_write_every == 0)
+        {
+            dev.stats.errors_injected++;
+            handle->error = L"injected write error";
+            return -1;
+        }
+
+        dev.stats.writes++;
+        dev.stats.bytes_written += length;
+
+        if (dev.config.loopback)
+        {
+            // Like a real device, a report id of 0 is not part of the report
+            if (data[0] == 0)
+                queueReport(dev, MockReport(data + 1, data + length));
+            else
+                queueReport(dev, MockReport(data, data + length));
+        }
+
+        return (int)length;
+    }
+
+    int HID_API_EXPORT hid_read_timeout(hid_device *handle, unsigned char *data, size_t length, int milliseconds)
+    {
+        if (!handle)
+            return -1;
+
+        auto &dev = *handle->device;
+        injectLatency(dev.config.read_latency_us);
+
+        std::unique_lock<std::mutex> lk(dev.lock);
+        if (dev.config.fail_read_every && ++dev.readCalls % dev.config.fail_read_every == 0)
+        {
+            dev.stats.errors_injected++;
+            handle->error = L"injected read error";
+            return -1;
+        }
+
+        auto deadline = MockClock::now() + std::chrono::milliseconds(std::max(milliseconds, 0));
+        while (true)
+        {
+            if (dev.removed)
+            {
+                handle->error = L"device disconnected";
+                return -1;
+            }
+
+            generateDue(dev, MockClock::now());
+            if (handle->queue.empty() && dev.config.reports_per_second == HID_MOCK_RATE_UNLIMITED)
+            {
+                queueReport(dev, makeReport(dev));
+            }
+
+            if (!handle->queue.empty())
+            {
+                MockReport &report = handle->queue.front();
+                size_t n = std::min(length, report.size());
+                memcpy(data, report.data(), n);
+                handle->queue.pop_front();
+                dev.stats.reports_read++;
+                return (int)n;
+            }
+
+            if (milliseconds == 0 || (milliseconds > 0 && MockClock::now() >= deadline))
+            {
+                return 0;
+            }
+
+            // Sleep until the next report is due, something is queued, or the timeout is reached
+            unsigned int rate = dev.config.reports_per_second;
+            if (rate != 0)
+            {
+                auto nextDue = dev.start + std::chrono::microseconds((dev.generated + 1) * 1000000 / rate);
+                dev.available.wait_until(lk, milliseconds > 0 ? std::min(nextDue, deadline) : nextDue);
+            }
+            else if (milliseconds > 0)
+            {
+                dev.available.wait_until(lk, deadline);
+            }
+            else
+            {
+                dev.available.wait(lk);
+            }
+        }
+    }
+
+    int HID_API_EXPORT hid_read(hid_device *handle, unsigned char *data, size_t length)
+    {
+        if (!handle)
+            return -1;
+        return hid_read_timeout(handle, data, length, handle->nonblocking ? 0 : -1);
+    }
+
+    int HID_API_EXPORT hid_set_nonblocking(hid_device *handle, int nonblock)
+    {
+        if (!handle)
+            return -1;
+        handle->nonblocking = nonblock != 0;
+        return 0;
+    }
+
+    int HID_API_EXPORT hid_send_feature_report(hid_device *handle, const unsigned char *data, size_t length)
+    {
+        if (!handle || !data || length == 0)
+            return -1;
+
+        auto &dev = *handle->device;
+        std::unique_lock<std::mutex> lk(dev.lock);
+        if (dev.removed)
+        {
+            handle->error = L"device disconnected";
+            return -1;
+        }
+
+        // Remember it, so that it can be read back
+        dev.features[data[0]] = MockReport(data, data + length);
+        dev.stats.feature_reports_sent++;
+        return (int)length;
+    }
+
+    int HID_API_EXPORT hid_get_feature_report(hid_device *handle, unsigned char *data, size_t length)
+    {
+        if (!handle || !data || length == 0)
+            return -1;
+
+        auto &dev = *handle->device;
+        std::unique_lock<std::mutex> lk(dev.lock);
+        if (dev.removed)
+        {
+            handle->error = L"device disconnected";
+            return -1;
+        }
+
+        auto it = dev.features.find(data[0]);
+        if (it == dev.features.end())
+        {
+            handle->error = L"feature report has not been sent";
+            return -1;
+        }
+
+        size_t n = std::min(length, it->second.size());
+        memcpy(data, it->second.data(), n);
+        dev.stats.feature_reports_read++;
+        return (int)n;
+    }
+
+    int HID_API_EXPORT hid_get_input_report(hid_device *handle, unsigned char *, size_t)
+    {
+        if (handle)
+            handle->error = L"not supported by the mock backend";
+        return -1;
+    }
+
+    static int copyDeviceString(hid_device *handle, bool has, const std::wstring &str, wchar_t *string, size_t maxlen)
+    {
+        if (!handle || !string || maxlen == 0)
+            return -1;
+
+        size_t n = has ? std::min(str.size(), maxlen - 1) : 0;
+        wmemcpy(string, str.c_str(), n);
+        string[n] = 0;
+        return 0;
+    }
+
+    int HID_API_EXPORT_CALL hid_get_manufacturer_string(hid_device *handle, wchar_t *string, size_t maxlen)
+    {
+        return handle ? copyDeviceString(handle, handle->device->hasManufacturer, handle->device->manufacturer, string, maxlen) : -1;
+    }
+
+    int HID_API_EXPORT_CALL hid_get_product_string(hid_device *handle, wchar_t *string, size_t maxlen)
+    {
+        return handle ? copyDeviceString(handle, handle->device->hasProduct, handle->device->product, string, maxlen) : -1;
+    }
+
+    int HID_API_EXPORT_CALL hid_get_serial_number_string(hid_device *handle, wchar_t *string, size_t maxlen)
+    {
+        return handle ? copyDeviceString(handle, handle->device->hasSerial, handle->device->serial, string, maxlen) : -1;
+    }
+
+    struct hid_device_info HID_API_EXPORT *hid_get_device_info(hid_device *handle)
+    {
+        if (!handle)
+            return nullptr;
+
+        if (!handle->info)
+            handle->info = makeDeviceInfo(*handle->device);
+        return handle->info;
+    }
+
+    int HID_API_EXPORT_CALL hid_get_indexed_string(hid_device *handle, int, wchar_t *, size_t)
+    {
+        if (handle)
+            handle->error = L"not supported by the mock backend";
+        return -1;
+    }
+
+    int HID_API_EXPORT_CALL hid_get_report_descriptor(hid_device *handle, unsigned char *buf, size_t buf_size)
+    {
+        if (!handle)
+            return -1;
+
+        auto &descriptor = handle->device->descriptor;
+        if (descriptor.empty())
+        {
+            handle->error = L"mock device has no report descriptor";
+            return -1;
+        }
+
+        size_t n = std::min(buf_size, descriptor.size());
+        memcpy(buf, descriptor.data(), n);
+        return (int)n;
+    }
+
+    HID_API_EXPORT const wchar_t *HID_API_CALL hid_error(hid_device *handle)
+    {
+        if (!handle)
+            return globalError.empty() ? L"Success" : globalError.c_str();
+        return handle->error.empty() ? L"Success" : handle->error.c_str();
+    }
+
+    HID_API_EXPORT const struct hid_api_version *HID_API_CALL hid_version(void)
+    {
+        static const struct hid_api_version version = {HID_API_VERSION_MAJOR, HID_API_VERSION_MINOR, HID_API_VERSION_PATCH};
+        return &version;
+    }
+
+    HID_API_EXPORT const char *HID_API_CALL hid_version_str(void)
+    {
+        return HID_API_VERSION_STR;
+    }
+}
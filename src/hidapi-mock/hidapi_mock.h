@@ -0,0 +1,104 @@
+#ifndef HIDAPI_MOCK_H__
+#define HIDAPI_MOCK_H__
+
+#include <hidapi.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** A reports_per_second value which generates a report whenever one is read */
+#define HID_MOCK_RATE_UNLIMITED 0xFFFFFFFFu
+
+    /**
+     * The description and behaviour of a virtual device.
+     * Use hid_mock_default_config to initialise one before changing the fields of interest
+     */
+    struct hid_mock_device_config
+    {
+        unsigned short vendor_id;
+        unsigned short product_id;
+        unsigned short release_number;
+        unsigned short usage_page;
+        unsigned short usage;
+        int interface_number;
+
+        /** Optional strings, copied when the device is added */
+        const wchar_t *serial_number;
+        const wchar_t *manufacturer_string;
+        const wchar_t *product_string;
+
+        /** Optional report descriptor, copied when the device is added */
+        const unsigned char *report_descriptor;
+        size_t report_descriptor_size;
+
+        /**
+         * Generated input reports. Each starts with input_report_id (if non-zero), then a 32bit little-endian sequence number, padded with zeros to input_report_size.
+         * They are generated at reports_per_second from when the device is first opened, with 0 disabling them
+         */
+        size_t input_report_size;
+        unsigned char input_report_id;
+        unsigned int reports_per_second;
+
+        /** When non-zero, every successful write is also queued as an input report */
+        int loopback;
+
+        /** Delay added to each read and write, in microseconds */
+        unsigned int read_latency_us;
+        unsigned int write_latency_us;
+
+        /** Make every nth read or write fail, with 0 disabling this */
+        unsigned int fail_read_every;
+        unsigned int fail_write_every;
+
+        /** The number of input reports queued for each open handle before the oldest are dropped */
+        size_t max_queued_reports;
+    };
+
+    struct hid_mock_device_stats
+    {
+        unsigned long long reports_generated;
+        unsigned long long reports_read;
+        unsigned long long reports_dropped;
+        unsigned long long writes;
+        unsigned long long bytes_written;
+        unsigned long long feature_reports_sent;
+        unsigned long long feature_reports_read;
+        unsigned long long errors_injected;
+    };
+
+    void HID_API_EXPORT_CALL hid_mock_default_config(struct hid_mock_device_config *config);
+
+    /**
+     * Add a virtual device.
+     * Returns its path, which remains valid until the device is removed, or NULL on failure
+     */
+    const char *HID_API_EXPORT_CALL hid_mock_add_device(const struct hid_mock_device_config *config);
+
+    /**
+     * Remove a virtual device. Any handles which are still open will fail from now on.
+     * Returns -1 if there is no such device
+     */
+    int HID_API_EXPORT_CALL hid_mock_remove_device(const char *path);
+
+    /**
+     * Queue an input report on every open handle of a device.
+     * Returns -1 if there is no such device
+     */
+    int HID_API_EXPORT_CALL hid_mock_push_input_report(const char *path, const unsigned char *data, size_t length);
+
+    /**
+     * Get the counters of a device.
+     * Returns -1 if there is no such device
+     */
+    int HID_API_EXPORT_CALL hid_mock_get_stats(const char *path, struct hid_mock_device_stats *stats);
+
+    /** Remove every virtual device */
+    void HID_API_EXPORT_CALL hid_mock_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HIDAPI_MOCK_H__
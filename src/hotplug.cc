@@ -0,0 +1,204 @@
+#include "hotplug.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <libudev.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+static std::tuple<std::string, unsigned short, unsigned short> deviceKey(const CachedDevice &dev)
+{
+    return std::make_tuple(dev.path, dev.usagePage, dev.usage);
+}
+
+HotplugMonitor::HotplugMonitor(EnumerationCache &cache, std::mutex &enumerateLock)
+    : cache(cache), enumerateLock(enumerateLock)
+{
+}
+
+HotplugMonitor::~HotplugMonitor()
+{
+    std::unique_lock<std::mutex> lk(threadLock);
+    Stop();
+}
+
+std::string HotplugMonitor::Subscribe(HotplugSubscriber *subscriber)
+{
+    std::unique_lock<std::mutex> lk(threadLock);
+
+    if (!thread.joinable())
+    {
+        udev = udev_new();
+        if (udev)
+            monitor = udev_monitor_new_from_netlink(udev, "udev");
+        if (monitor)
+            udev_monitor_filter_add_match_subsystem_devtype(monitor, "hidraw", nullptr);
+        if (!monitor || udev_monitor_enable_receiving(monitor) < 0)
+        {
+            Stop();
+            return "unable to monitor udev for device changes";
+        }
+
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeFd < 0)
+        {
+            Stop();
+            return "unable to create eventfd";
+        }
+
+        thread = std::thread(&HotplugMonitor::Run, this);
+    }
+
+    std::unique_lock<std::mutex> lk2(lock);
+    subscribers.push_back(subscriber);
+    return "";
+}
+
+void HotplugMonitor::Unsubscribe(HotplugSubscriber *subscriber)
+{
+    std::unique_lock<std::mutex> lk(threadLock);
+
+    bool empty;
+    {
+        std::unique_lock<std::mutex> lk2(lock);
+        subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscriber), subscribers.end());
+        empty = subscribers.empty();
+    }
+
+    if (empty)
+    {
+        Stop();
+    }
+}
+
+void HotplugMonitor::Stop()
+{
+    if (thread.joinable())
+    {
+        uint64_t value = 1;
+        if (write(wakeFd, &value, sizeof(value)) < 0)
+        {
+            // Can't happen for a fresh eventfd
+        }
+        thread.join();
+    }
+
+    if (wakeFd >= 0)
+    {
+        close(wakeFd);
+        wakeFd = -1;
+    }
+    if (monitor)
+    {
+        udev_monitor_unref(monitor);
+        monitor = nullptr;
+    }
+    if (udev)
+    {
+        udev_unref(udev);
+        udev = nullptr;
+    }
+}
+
+CachedDeviceList HotplugMonitor::Enumerate()
+{
+    CachedDeviceList devices;
+
+    std::unique_lock<std::mutex> lk(enumerateLock);
+    hid_device_info *devs = hid_enumerate(0, 0);
+    for (hid_device_info *dev = devs; dev; dev = dev->next)
+    {
+        devices.push_back(std::make_shared<const CachedDevice>(dev));
+    }
+    hid_free_enumeration(devs);
+
+    return devices;
+}
+
+void HotplugMonitor::Run()
+{
+    // Enumerating can be slow, so the baseline is taken here rather than holding up Subscribe.
+    // The monitor is already receiving, so nothing can be missed between this and polling it
+    known.clear();
+    for (auto &dev : Enumerate())
+    {
+        known[deviceKey(*dev)] = dev;
+    }
+
+    struct pollfd fds[2] = {
+        {udev_monitor_get_fd(monitor), POLLIN, 0},
+        {wakeFd, POLLIN, 0},
+    };
+
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            std::string message = std::string("unable to wait for device changes: ") + strerror(errno);
+            std::unique_lock<std::mutex> lk(lock);
+            for (auto subscriber : subscribers)
+            {
+                subscriber->OnError(message);
+            }
+            return;
+        }
+        if (fds[1].revents)
+        {
+            return;
+        }
+
+        // Drain everything queued, as a burst of events only needs one enumeration
+        struct udev_device *dev;
+        while ((dev = udev_monitor_receive_device(monitor)) != nullptr)
+        {
+            udev_device_unref(dev);
+        }
+
+        cache.invalidate();
+
+        CachedDeviceList attached;
+        CachedDeviceList detached;
+        std::map<std::tuple<std::string, unsigned short, unsigned short>, std::shared_ptr<const CachedDevice>> current;
+        for (auto &dev : Enumerate())
+        {
+            auto key = deviceKey(*dev);
+            auto it = known.find(key);
+            if (it == known.end())
+            {
+                attached.push_back(dev);
+            }
+            else if (!(*it->second == *dev))
+            {
+                // A different device has taken over the path
+                detached.push_back(it->second);
+                attached.push_back(dev);
+            }
+            current[key] = dev;
+        }
+        for (auto &entry : known)
+        {
+            if (current.find(entry.first) == current.end())
+            {
+                detached.push_back(entry.second);
+            }
+        }
+        known.swap(current);
+
+        if (attached.empty() && detached.empty())
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(lock);
+        for (auto subscriber : subscribers)
+        {
+            subscriber->OnChange(attached, detached);
+        }
+    }
+}
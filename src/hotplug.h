@@ -0,0 +1,81 @@
+#ifndef NODEHID_HOTPLUG_H__
+#define NODEHID_HOTPLUG_H__
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "enumeration.h"
+
+struct udev;
+struct udev_monitor;
+
+/**
+ * Something to be told about devices being added and removed
+ */
+class HotplugSubscriber
+{
+public:
+    virtual ~HotplugSubscriber() {}
+
+    /**
+     * Called on the monitor thread when devices have been added or removed.
+     * This must not block, or call back into the monitor
+     */
+    virtual void OnChange(const CachedDeviceList &attached, const CachedDeviceList &detached) = 0;
+
+    /**
+     * Called on the monitor thread when it has failed, after which there will be no more changes until every subscriber has unsubscribed.
+     * This must not block, or call back into the monitor
+     */
+    virtual void OnError(const std::string &message) = 0;
+};
+
+/**
+ * Watches udev for hidraw devices being added and removed, on a single thread shared by every subscriber.
+ * The devices are enumerated whenever udev reports a change, and compared to the previous enumeration to find what changed.
+ * The thread only runs while there are subscribers
+ */
+class HotplugMonitor
+{
+public:
+    HotplugMonitor(EnumerationCache &cache, std::mutex &enumerateLock);
+    ~HotplugMonitor();
+
+    /**
+     * Start notifying the subscriber, starting the thread if needed.
+     * Returns a non-empty string upon failure
+     */
+    std::string Subscribe(HotplugSubscriber *subscriber);
+
+    /**
+     * Stop notifying the subscriber. Once this returns, it will not be called again
+     */
+    void Unsubscribe(HotplugSubscriber *subscriber);
+
+private:
+    void Run();
+    void Stop();
+    CachedDeviceList Enumerate();
+
+    EnumerationCache &cache;
+    std::mutex &enumerateLock;
+
+    // Serializes starting and stopping the thread
+    std::mutex threadLock;
+    std::thread thread;
+    int wakeFd = -1;
+    struct udev *udev = nullptr;
+    struct udev_monitor *monitor = nullptr;
+
+    std::mutex lock;
+    std::vector<HotplugSubscriber *> subscribers;
+
+    // The devices seen by the last enumeration, by path and usage. Only accessed from the monitor thread, which fills it in when it starts
+    std::map<std::tuple<std::string, unsigned short, unsigned short>, std::shared_ptr<const CachedDevice>> known;
+};
+
+#endif // NODEHID_HOTPLUG_H__
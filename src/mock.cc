@@ -0,0 +1,174 @@
+#include "mock.h"
+
+#include "hidapi-mock/hidapi_mock.h"
+
+static uint32_t getUint32Option(const Napi::Object &options, const char *name, uint32_t defaultValue)
+{
+    Napi::Value value = options.Get(name);
+    return value.IsNumber() ? value.As<Napi::Number>().Uint32Value() : defaultValue;
+}
+
+static Napi::Value addDevice(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() != 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "addDevice needs an options object").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object options = info[0].As<Napi::Object>();
+
+    hid_mock_device_config config;
+    hid_mock_default_config(&config);
+
+    config.vendor_id = getUint32Option(options, "vendorId", 0);
+    config.product_id = getUint32Option(options, "productId", 0);
+    config.release_number = getUint32Option(options, "release", 0);
+    config.usage_page = getUint32Option(options, "usagePage", 0);
+    config.usage = getUint32Option(options, "usage", 0);
+    config.interface_number = options.Get("interface").IsNumber() ? options.Get("interface").As<Napi::Number>().Int32Value() : -1;
+
+    // These must outlive the call to hid_mock_add_device, which copies them
+    std::wstring serialNumber, manufacturer, product;
+    if (options.Get("serialNumber").IsString())
+    {
+        serialNumber = utf8_decode(options.Get("serialNumber").As<Napi::String>().Utf8Value());
+        config.serial_number = serialNumber.c_str();
+    }
+    if (options.Get("manufacturer").IsString())
+    {
+        manufacturer = utf8_decode(options.Get("manufacturer").As<Napi::String>().Utf8Value());
+        config.manufacturer_string = manufacturer.c_str();
+    }
+    if (options.Get("product").IsString())
+    {
+        product = utf8_decode(options.Get("product").As<Napi::String>().Utf8Value());
+        config.product_string = product.c_str();
+    }
+
+    std::vector<unsigned char> descriptor;
+    if (!options.Get("reportDescriptor").IsUndefined())
+    {
+        std::string copyError = copyArrayOrBufferIntoVector(options.Get("reportDescriptor"), descriptor);
+        if (copyError != "")
+        {
+            Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        config.report_descriptor = descriptor.data();
+        config.report_descriptor_size = descriptor.size();
+    }
+
+    config.input_report_size = getUint32Option(options, "inputReportSize", config.input_report_size);
+    config.input_report_id = getUint32Option(options, "inputReportId", 0);
+
+    Napi::Value rate = options.Get("reportsPerSecond");
+    if (rate.IsNumber())
+    {
+        double value = rate.As<Napi::Number>().DoubleValue();
+        config.reports_per_second = value >= HID_MOCK_RATE_UNLIMITED ? HID_MOCK_RATE_UNLIMITED : (unsigned int)value;
+    }
+
+    config.loopback = options.Get("loopback").ToBoolean().Value();
+    config.read_latency_us = getUint32Option(options, "readLatencyUs", 0);
+    config.write_latency_us = getUint32Option(options, "writeLatencyUs", 0);
+    config.fail_read_every = getUint32Option(options, "failReadEvery", 0);
+    config.fail_write_every = getUint32Option(options, "failWriteEvery", 0);
+    config.max_queued_reports = getUint32Option(options, "maxQueuedReports", config.max_queued_reports);
+
+    const char *path = hid_mock_add_device(&config);
+    if (!path)
+    {
+        Napi::TypeError::New(env, "unable to add mock device").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    return Napi::String::New(env, path);
+}
+
+static Napi::Value removeDevice(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() != 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "removeDevice needs a path").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    return Napi::Boolean::New(env, hid_mock_remove_device(info[0].As<Napi::String>().Utf8Value().c_str()) == 0);
+}
+
+static Napi::Value pushInputReport(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() != 2 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "pushInputReport needs a path and a report").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::vector<unsigned char> report;
+    std::string copyError = copyArrayOrBufferIntoVector(info[1], report);
+    if (copyError != "")
+    {
+        Napi::TypeError::New(env, copyError).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (hid_mock_push_input_report(info[0].As<Napi::String>().Utf8Value().c_str(), report.data(), report.size()) != 0)
+    {
+        Napi::TypeError::New(env, "no such mock device").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    return env.Null();
+}
+
+static Napi::Value getStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() != 1 || !info[0].IsString())
+    {
+        Napi::TypeError::New(env, "getStats needs a path").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    hid_mock_device_stats stats;
+    if (hid_mock_get_stats(info[0].As<Napi::String>().Utf8Value().c_str(), &stats) != 0)
+    {
+        Napi::TypeError::New(env, "no such mock device").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("reportsGenerated", Napi::Number::New(env, (double)stats.reports_generated));
+    result.Set("reportsRead", Napi::Number::New(env, (double)stats.reports_read));
+    result.Set("reportsDropped", Napi::Number::New(env, (double)stats.reports_dropped));
+    result.Set("writes", Napi::Number::New(env, (double)stats.writes));
+    result.Set("bytesWritten", Napi::Number::New(env, (double)stats.bytes_written));
+    result.Set("featureReportsSent", Napi::Number::New(env, (double)stats.feature_reports_sent));
+    result.Set("featureReportsRead", Napi::Number::New(env, (double)stats.feature_reports_read));
+    result.Set("errorsInjected", Napi::Number::New(env, (double)stats.errors_injected));
+    return result;
+}
+
+static Napi::Value reset(const Napi::CallbackInfo &info)
+{
+    hid_mock_reset();
+    return info.Env().Null();
+}
+
+Napi::Object createMockControl(const Napi::Env &env)
+{
+    Napi::Object mock = Napi::Object::New(env);
+    mock.Set("addDevice", Napi::Function::New(env, &addDevice));
+    mock.Set("removeDevice", Napi::Function::New(env, &removeDevice));
+    mock.Set("pushInputReport", Napi::Function::New(env, &pushInputReport));
+    mock.Set("getStats", Napi::Function::New(env, &getStats));
+    mock.Set("reset", Napi::Function::New(env, &reset));
+    return mock;
+}
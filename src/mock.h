@@ -0,0 +1,11 @@
+#ifndef NODEHID_MOCK_H__
+#define NODEHID_MOCK_H__
+
+#include "util.h"
+
+/**
+ * Create the object used to control the virtual devices of the mock backend
+ */
+Napi::Object createMockControl(const Napi::Env &env);
+
+#endif // NODEHID_MOCK_H__
@@ -0,0 +1,271 @@
+#include "reactor.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+// How many events to collect from each call to epoll_wait
+#define REACTOR_MAX_EVENTS 64
+
+ReadReactor::ReadReactor(int threadCount)
+{
+    for (int i = 0; i < threadCount; i++)
+    {
+        auto state = std::unique_ptr<ReactorThread>(new ReactorThread);
+        state->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        state->shutdownFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        state->addFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (state->epollFd < 0 || state->shutdownFd < 0 || state->addFd < 0)
+        {
+            if (state->epollFd >= 0)
+                close(state->epollFd);
+            if (state->shutdownFd >= 0)
+                close(state->shutdownFd);
+            if (state->addFd >= 0)
+                close(state->addFd);
+            continue;
+        }
+
+        // A null pointer marks the shutdown event
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(state->epollFd, EPOLL_CTL_ADD, state->shutdownFd, &ev);
+
+        // And a tag without a source marks new sources to attach
+        ev.data.ptr = &state->addTag;
+        epoll_ctl(state->epollFd, EPOLL_CTL_ADD, state->addFd, &ev);
+
+        ReactorThread *ptr = state.get();
+        state->thread = std::thread([this, ptr]()
+                                    { Run(ptr); });
+        threads.push_back(std::move(state));
+    }
+}
+
+ReadReactor::~ReadReactor()
+{
+    for (auto &state : threads)
+    {
+        uint64_t value = 1;
+        if (write(state->shutdownFd, &value, sizeof(value)) < 0)
+        {
+            // Can't happen for a fresh eventfd
+        }
+    }
+
+    for (auto &state : threads)
+    {
+        if (state->thread.joinable())
+        {
+            state->thread.join();
+        }
+
+        // Any sources still attached or waiting to be are leaked, as their devices were never closed
+        close(state->epollFd);
+        close(state->shutdownFd);
+        close(state->addFd);
+    }
+}
+
+bool ReadReactor::Add(ReactorSource *source)
+{
+    // Spread the sources over the threads which are still working
+    ReactorThread *state = nullptr;
+    size_t best = 0;
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        if (threads[i]->failed)
+            continue;
+        if (!state || threads[i]->sourceCount < state->sourceCount)
+        {
+            state = threads[i].get();
+            best = i;
+        }
+    }
+    if (!state)
+    {
+        return false;
+    }
+
+    source->thread = best;
+    source->tags[0] = {source, false};
+    source->tags[1] = {source, true};
+
+    {
+        std::unique_lock<std::mutex> lock(state->pendingLock);
+        if (state->failed)
+        {
+            // It failed since it was chosen
+            return false;
+        }
+
+        // Counted straight away, so that a burst of sources is still spread over the threads
+        state->sourceCount++;
+        state->pending.push_back(source);
+    }
+
+    uint64_t value = 1;
+    if (write(state->addFd, &value, sizeof(value)) < 0)
+    {
+        // The eventfd counter can't overflow from this, so there is nothing to handle
+    }
+    return true;
+}
+
+bool ReadReactor::Watch(ReactorThread *state, ReactorSource *source)
+{
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &source->tags[0];
+    if (epoll_ctl(state->epollFd, EPOLL_CTL_ADD, source->fd, &ev) < 0)
+    {
+        return false;
+    }
+
+    ev.data.ptr = &source->tags[1];
+    if (epoll_ctl(state->epollFd, EPOLL_CTL_ADD, source->wakeFd, &ev) < 0)
+    {
+        epoll_ctl(state->epollFd, EPOLL_CTL_DEL, source->fd, nullptr);
+        return false;
+    }
+
+    source->watched = true;
+    state->sources.push_back(source);
+    return true;
+}
+
+void ReadReactor::Fail(ReactorThread *state, std::vector<ReactorSource *> &detached)
+{
+    std::vector<ReactorSource *> adding;
+    {
+        std::unique_lock<std::mutex> lock(state->pendingLock);
+        state->failed = true;
+        adding.swap(state->pending);
+    }
+
+    for (auto source : adding)
+    {
+        state->sourceCount--;
+        source->failed = true;
+        source->detached = true;
+        detached.push_back(source);
+    }
+
+    // Detach removes from sources, so work from a copy
+    auto watching = state->sources;
+    for (auto source : watching)
+    {
+        source->failed = true;
+        Detach(state, source, detached);
+    }
+}
+
+void ReadReactor::AttachPending(ReactorThread *state, std::vector<ReactorSource *> &detached)
+{
+    uint64_t value;
+    if (read(state->addFd, &value, sizeof(value)) < 0)
+    {
+        // Nothing was pending
+    }
+
+    std::vector<ReactorSource *> adding;
+    {
+        std::unique_lock<std::mutex> lock(state->pendingLock);
+        adding.swap(state->pending);
+    }
+
+    for (auto source : adding)
+    {
+        if (!source->OnAttach() || !Watch(state, source))
+        {
+            state->sourceCount--;
+            source->detached = true;
+            detached.push_back(source);
+            continue;
+        }
+
+        // Anything which arrived before the source was watched won't cause a wake, so collect it now
+        if (!source->OnReadable())
+        {
+            Detach(state, source, detached);
+        }
+    }
+}
+
+void ReadReactor::Detach(ReactorThread *state, ReactorSource *source, std::vector<ReactorSource *> &detached)
+{
+    if (source->detached)
+    {
+        return;
+    }
+
+    epoll_ctl(state->epollFd, EPOLL_CTL_DEL, source->fd, nullptr);
+    epoll_ctl(state->epollFd, EPOLL_CTL_DEL, source->wakeFd, nullptr);
+    state->sources.erase(std::remove(state->sources.begin(), state->sources.end(), source), state->sources.end());
+    state->sourceCount--;
+
+    // Other events for this source may be later in the current batch, so it must not be freed until they have been skipped
+    source->detached = true;
+    detached.push_back(source);
+}
+
+void ReadReactor::Run(ReactorThread *state)
+{
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    std::vector<ReactorSource *> detached;
+
+    bool exiting = false;
+    while (!exiting)
+    {
+        int count = epoll_wait(state->epollFd, events, REACTOR_MAX_EVENTS, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // Waiting again would fail the same way, so give up on everything this thread was watching
+            Fail(state, detached);
+            count = 0;
+            exiting = true;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            auto tag = static_cast<ReactorSource::Tag *>(events[i].data.ptr);
+            if (tag == nullptr)
+            {
+                // The reactor is being destroyed, but anything already detached must still be told
+                exiting = true;
+                break;
+            }
+
+            ReactorSource *source = tag->source;
+            if (source == nullptr)
+            {
+                AttachPending(state, detached);
+                continue;
+            }
+            if (source->detached)
+            {
+                continue;
+            }
+
+            if (tag->isWake || !source->OnReadable())
+            {
+                Detach(state, source, detached);
+            }
+        }
+
+        for (auto source : detached)
+        {
+            source->OnDetached();
+        }
+        detached.clear();
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef NODEHID_REACTOR_H__
+#define NODEHID_REACTOR_H__
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Something which can be watched by the ReadReactor.
+ * It is watched until either OnReadable returns false, or its wakeFd becomes readable.
+ */
+class ReactorSource
+{
+public:
+    virtual ~ReactorSource() {}
+
+    /**
+     * Called on the reactor thread which will watch the source, before it is watched, so that any slow setup is kept off the thread which added it.
+     * The fds to watch must be set by this. Return false if the source can't be watched, in which case OnDetached is called straight away
+     */
+    virtual bool OnAttach() { return true; }
+
+    /**
+     * Called on a reactor thread when fd is readable, or has an error.
+     * Return false to stop watching the source
+     */
+    virtual bool OnReadable() = 0;
+
+    /**
+     * Called on a reactor thread once the source has been removed, after which it will not be used by the reactor again.
+     * The source is allowed to delete itself here
+     */
+    virtual void OnDetached() = 0;
+
+protected:
+    ReactorSource() {}
+
+    void SetFds(int newFd, int newWakeFd)
+    {
+        fd = newFd;
+        wakeFd = newWakeFd;
+    }
+
+    // Whether the fds were successfully added to the reactor
+    bool IsWatched() const { return watched; }
+    // Whether the source was detached because its reactor thread failed
+    bool HasFailed() const { return failed; }
+
+private:
+    friend class ReadReactor;
+
+    struct Tag
+    {
+        ReactorSource *source;
+        bool isWake;
+    };
+
+    int fd = -1;
+    int wakeFd = -1;
+    Tag tags[2];
+
+    bool watched = false;
+    bool failed = false;
+    bool detached = false;
+    size_t thread = 0;
+};
+
+/**
+ * A fixed set of threads, which between them wait on the file descriptors of any number of devices using epoll.
+ * This avoids needing a thread for every device which is being read from.
+ */
+class ReadReactor
+{
+public:
+    ReadReactor(int threadCount);
+    ~ReadReactor();
+
+    int ThreadCount() const { return (int)threads.size(); }
+
+    /**
+     * Start watching a source. This may be called from any thread, with the source then being attached from a reactor thread.
+     * Returns false if the reactor has no working threads, in which case the source is untouched
+     */
+    bool Add(ReactorSource *source);
+
+private:
+    struct ReactorThread
+    {
+        int epollFd = -1;
+        // Used to ask the thread to exit
+        int shutdownFd = -1;
+        // Used to tell the thread that there are sources to attach
+        int addFd = -1;
+        ReactorSource::Tag addTag = {nullptr, false};
+
+        std::mutex pendingLock;
+        std::vector<ReactorSource *> pending;
+        // Set once the thread has stopped because epoll failed, so that no more sources are given to it. Written with pendingLock held
+        std::atomic<bool> failed = {false};
+
+        // The sources being watched. Only accessed from the thread
+        std::vector<ReactorSource *> sources;
+
+        std::atomic<int> sourceCount = {0};
+        std::thread thread;
+    };
+
+    void Run(ReactorThread *state);
+    void AttachPending(ReactorThread *state, std::vector<ReactorSource *> &detached);
+    bool Watch(ReactorThread *state, ReactorSource *source);
+    void Fail(ReactorThread *state, std::vector<ReactorSource *> &detached);
+    void Detach(ReactorThread *state, ReactorSource *source, std::vector<ReactorSource *> &detached);
+
+    std::vector<std::unique_ptr<ReactorThread>> threads;
+};
+
+#endif // NODEHID_REACTOR_H__
@@ -1,79 +1,1669 @@
 #include "read.h"
+#include "descriptor.h"
+#include "filter.h"
+
+#ifdef NODE_HID_HIDRAW
+#include "reactor.h"
+#endif
+
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <deque>
+
+#ifdef NODE_HID_HIDRAW
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
+// Reports are read into buffers at least this large, to protect against devices which send more than their descriptor declares
+#define READ_BUFF_MINSIZE 64
+// Larger values of batchSize are clamped to this, which keeps each pooled buffer to a few megabytes at most
+#define READ_MAX_BATCH_SIZE 1024
+// The slowest maxRate, in reports per second
+#define READ_MIN_MAX_RATE 0.001
+
+/**
+ * A pool of equally sized buffers, to avoid an allocation for every report read.
+ * Buffers are handed to javascript as external Buffers, which return their memory to the pool once garbage collected.
+ * The pool is reference counted by the read thread and every outstanding Buffer, as either could be the last user of it.
+ */
+class ReportBufferPool
+{
+public:
+    ReportBufferPool(size_t slotSize) : slotSize(slotSize) {}
+
+    // Take a buffer from the pool. This may be called from any thread
+    unsigned char *Acquire();
+    // Return a buffer to the pool. This may be called from any thread
+    void Release(unsigned char *slot);
+
+    void Ref();
+    void Unref();
+
+    const size_t slotSize;
+
+private:
+    ~ReportBufferPool();
+
+    // Limit how many idle buffers are retained after a burst of reports
+    static const size_t maxFreeSlots = 32;
+
+    std::atomic<int> refs = {1};
+
+    std::mutex lock;
+    std::vector<unsigned char *> freeSlots;
+};
+
+ReportBufferPool::~ReportBufferPool()
+{
+    for (auto slot : freeSlots)
+    {
+        delete[] slot;
+    }
+}
+
+unsigned char *ReportBufferPool::Acquire()
+{
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        if (!freeSlots.empty())
+        {
+            unsigned char *slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+    }
+
+    return new unsigned char[slotSize];
+}
+
+void ReportBufferPool::Release(unsigned char *slot)
+{
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        if (freeSlots.size() < maxFreeSlots)
+        {
+            freeSlots.push_back(slot);
+            return;
+        }
+    }
+
+    delete[] slot;
+}
+
+void ReportBufferPool::Ref()
+{
+    refs++;
+}
+
+void ReportBufferPool::Unref()
+{
+    if (--refs == 0)
+    {
+        delete this;
+    }
+}
+
+static void FinalizePooledBuffer(napi_env, void *data, void *hint)
+{
+    auto pool = static_cast<ReportBufferPool *>(hint);
+    pool->Release(static_cast<unsigned char *>(data));
+    pool->Unref();
+}
+
+/**
+ * Wrap a pooled buffer in a Buffer without copying, taking ownership of it.
+ * Some runtimes (such as electron) forbid external buffers, in which case the data gets copied instead
+ */
+static Napi::Value WrapPooledBuffer(const Napi::Env &env, ReportBufferPool *pool, unsigned char *buf, size_t len)
+{
+    napi_value result;
+    pool->Ref();
+    if (napi_create_external_buffer(env, len, buf, FinalizePooledBuffer, pool, &result) == napi_ok)
+    {
+        return Napi::Value(env, result);
+    }
+
+    pool->Unref();
+    auto copy = Napi::Buffer<unsigned char>::Copy(env, buf, len);
+    pool->Release(buf);
+    return copy;
+}
+
+std::string getReportDescriptor(hid_device *hid, std::vector<unsigned char> &descriptor)
+{
+#if HID_API_VERSION >= HID_API_MAKE_VERSION(0, 14, 0)
+    descriptor.resize(HID_API_MAX_REPORT_DESCRIPTOR_SIZE);
+    int res = hid_get_report_descriptor(hid, descriptor.data(), descriptor.size());
+    if (res < 0)
+    {
+        descriptor.clear();
+        return "could not get report descriptor from device";
+    }
+    descriptor.resize(res);
+    return "";
+#else
+    return "getting the report descriptor is not supported by this version of hidapi";
+#endif
+}
+
+InterruptibleReader::InterruptibleReader(hid_device *hid, DeviceStats *stats) : hid(hid), stats(stats)
+{
+#if defined(NODE_HID_HIDRAW) && HID_API_VERSION >= HID_API_MAKE_VERSION(0, 13, 0)
+    hid_device_info *info = hid_get_device_info(hid);
+    if (info && info->path)
+    {
+        fd = open(info->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wakeFd < 0)
+            {
+                // Fallback to polling through hidapi
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+#endif
+}
+
+InterruptibleReader::~InterruptibleReader()
+{
+#ifdef NODE_HID_HIDRAW
+    if (fd >= 0)
+    {
+        ::close(fd);
+        ::close(wakeFd);
+    }
+#endif
+}
+
+int InterruptibleReader::Read(unsigned char *buf, size_t length, int milliseconds)
+{
+    int len = ReadReport(buf, length, milliseconds);
+    if (len > 0)
+    {
+        // Taken straight away, so that it doesn't include any time spent handling the report
+        receivedAt = monotonicNow();
+    }
+
+    uint64_t readSequence = stats->countRead(len);
+    if (len > 0)
+    {
+        sequence = readSequence;
+    }
+    return len;
+}
+
+int InterruptibleReader::ReadReport(unsigned char *buf, size_t length, int milliseconds)
+{
+    if (interrupted)
+    {
+        return 0;
+    }
+
+#ifdef NODE_HID_HIDRAW
+    if (fd >= 0)
+    {
+        // Reports are always taken from the hidapi handle, so that nothing queued there before our handle was opened is missed.
+        // Our handle is given a copy of every later report, and is only used to wait for them
+        uint64_t deadline = milliseconds > 0 ? monotonicNow() + (uint64_t)milliseconds * 1000000 : 0;
+        while (!interrupted)
+        {
+            int len = hid_read_timeout(hid, buf, length, 0);
+            if (len != 0)
+            {
+                return len;
+            }
+
+            // Only discard the copies once hidapi has nothing left, so that our handle stays readable while it does.
+            // Anything arriving after this is found by checking again, or wakes the poll
+            unsigned char discard[READ_BUFF_MAXSIZE];
+            while (read(fd, discard, sizeof(discard)) > 0)
+            {
+            }
+            len = hid_read_timeout(hid, buf, length, 0);
+            if (len != 0)
+            {
+                return len;
+            }
+
+            int wait = milliseconds;
+            if (milliseconds > 0)
+            {
+                uint64_t now = monotonicNow();
+                wait = now < deadline ? (int)((deadline - now + 999999) / 1000000) : 0;
+            }
+
+            struct pollfd fds[2] = {{fd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+            int ret = poll(fds, 2, wait);
+            if (ret < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            if (ret == 0 || fds[1].revents)
+            {
+                // Timed out or interrupted
+                return 0;
+            }
+            if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+#endif
+
+    int mswait = 50;
+    int remaining = milliseconds;
+    while (!interrupted)
+    {
+        int wait = (milliseconds < 0 || remaining > mswait) ? mswait : remaining;
+        int len = hid_read_timeout(hid, buf, length, wait);
+        if (len != 0)
+        {
+            return len;
+        }
+
+        if (milliseconds >= 0)
+        {
+            remaining -= wait;
+            if (remaining <= 0)
+                break;
+        }
+    }
+    return 0;
+}
+
+void InterruptibleReader::Interrupt()
+{
+    interrupted = true;
+
+#ifdef NODE_HID_HIDRAW
+    if (wakeFd >= 0)
+    {
+        uint64_t value = 1;
+        if (write(wakeFd, &value, sizeof(value)) < 0)
+        {
+            // The eventfd counter can't overflow from this, so there is nothing to handle
+        }
+    }
+#endif
+}
+
+void InterruptibleReader::Reset()
+{
+#ifdef NODE_HID_HIDRAW
+    if (wakeFd >= 0)
+    {
+        uint64_t value;
+        if (read(wakeFd, &value, sizeof(value)) < 0)
+        {
+            // Nothing was pending
+        }
+    }
+#endif
+
+    interrupted = false;
+}
 
 struct ReadCallbackContext;
 
-struct ReadCallbackProps
+struct ReadCallbackProps
+{
+    unsigned char *buf;
+    int len;
+
+    // When the callback was queued, for the callback lag statistics
+    uint64_t queuedAt;
+
+    // When the report was read and its sequence number. For a batch, these are of the first report
+    uint64_t receivedAt;
+    uint64_t sequence;
+    // When batching, the time and sequence number of each report in turn
+    std::vector<uint64_t> stamps;
+
+    // Set when this is the reply to a transaction, rather than a report for the callback
+    uint32_t transaction = 0;
+
+    // Set to the command of a message reassembled by the framer, which is held in message rather than buf
+    int command = -1;
+    std::vector<unsigned char> message;
+
+    // When batching, the start of each report in buf followed by the total length
+    std::vector<uint32_t> offsets;
+};
+
+using Context = ReadCallbackContext;
+using DataType = ReadCallbackProps;
+void ReadCallback(Napi::Env env, Napi::Function callback, Context *context, DataType *data);
+using TSFN = Napi::TypedThreadSafeFunction<Context, DataType, ReadCallback>;
+using FinalizerDataType = void;
+
+struct ReadCallbackContext
+{
+    std::shared_ptr<ReadThreadState> state;
+
+    std::shared_ptr<DeviceContext> _hidHandle;
+    std::thread read_thread;
+
+    ReadOptions options;
+
+    // The largest report that can be read
+    size_t reportSize = READ_BUFF_MAXSIZE;
+    // Whether the first byte of each report is its id
+    bool numberedReports = true;
+    // Buffers handed to ReadCallback. Each can hold a full batch of reports
+    ReportBufferPool *pool = nullptr;
+
+    InterruptibleReader *reader = nullptr;
+
+    // Set when the reads are being done by the shared reactor rather than read_thread
+    std::shared_ptr<ReadReactor> reactor;
+    // The reactor may hand the reads over to read_thread from its own thread, so these are guarded by this
+    std::mutex threadLock;
+
+    TSFN read_callback;
+
+    // Reports waiting to be delivered to javascript. These are all handed over by a single call of the tsfn, so that they can still be dropped or replaced while waiting
+    std::mutex pendingLock;
+    std::condition_variable pendingSpace;
+    std::deque<ReadCallbackProps *> pending;
+    // Whether a call of the tsfn is already on its way to collect the pending reports
+    bool drainScheduled = false;
+
+    // Set when decoding, once the descriptor has been parsed
+    std::unique_ptr<ReportDecoder> decoder;
+    // The array that decoded values are delivered in, which is reused for every report. Only accessed from the main thread
+    Napi::ObjectReference values;
+    int32_t *valuesData = nullptr;
+
+    // Replaces the default message of an error
+    std::string error;
+
+    // Set with changesOnly
+    std::unique_ptr<ChangeFilter> changeFilter;
+    // Set with maxRate, along with the latest report of each id which it is holding back. Only accessed from the read thread
+    std::unique_ptr<RateLimiter> rateLimiter;
+    struct HeldReport
+    {
+        unsigned char *buf = nullptr;
+        int len = 0;
+        uint64_t receivedAt = 0;
+        uint64_t sequence = 0;
+    } held[256];
+    size_t heldCount = 0;
+
+    // Set when reports are written into a ring instead of being passed to the callback
+    std::unique_ptr<ReportRing> ring;
+
+    // Set when framing
+    std::unique_ptr<Reassembler> reassembler;
+};
+
+// Passed to the tsfn to deliver the pending reports. A null report is used to signal an error
+static ReadCallbackProps drainSignal;
+// Passed to the tsfn once reports are being read
+static ReadCallbackProps readySignal;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the ring header must be plain 32 bit words");
+
+bool ReportRing::Init(size_t reportSize)
+{
+    // Keep every slot aligned for the words in its header
+    slotSize = (uint32_t)((RING_SLOT_HEADER_SIZE + reportSize + 7) & ~(size_t)7);
+
+    // A power of two, so that slots stay in order when the counters wrap around
+    size_t fits = length > RING_HEADER_SIZE ? (length - RING_HEADER_SIZE) / slotSize : 0;
+    slotCount = 1;
+    while (slotCount * 2 <= fits && slotCount < 0x40000000)
+    {
+        slotCount *= 2;
+    }
+    if (fits == 0)
+    {
+        slotCount = 0;
+        return false;
+    }
+
+    Word(RING_HEAD).store(0, std::memory_order_relaxed);
+    Word(RING_TAIL).store(0, std::memory_order_relaxed);
+    Word(RING_SLOT_COUNT).store(slotCount, std::memory_order_relaxed);
+    Word(RING_SLOT_SIZE).store(slotSize, std::memory_order_relaxed);
+    Word(RING_DROPPED).store(0, std::memory_order_relaxed);
+    SetState(RING_STATE_RUNNING);
+    return true;
+}
+
+unsigned char *ReportRing::NextSlot()
+{
+    uint32_t head = Word(RING_HEAD).load(std::memory_order_relaxed);
+    uint32_t tail = Word(RING_TAIL).load(std::memory_order_acquire);
+    if (head - tail >= slotCount)
+    {
+        return nullptr;
+    }
+
+    return memory + RING_HEADER_SIZE + (size_t)(head % slotCount) * slotSize + RING_SLOT_HEADER_SIZE;
+}
+
+void ReportRing::Publish(size_t len, uint64_t receivedAt, uint64_t sequence)
+{
+    uint32_t head = Word(RING_HEAD).load(std::memory_order_relaxed);
+    auto slot = reinterpret_cast<uint32_t *>(memory + RING_HEADER_SIZE + (size_t)(head % slotCount) * slotSize);
+    slot[0] = (uint32_t)sequence;
+    slot[1] = (uint32_t)len;
+    slot[2] = (uint32_t)receivedAt;
+    slot[3] = (uint32_t)(receivedAt >> 32);
+
+    Word(RING_HEAD).store(head + 1, std::memory_order_release);
+}
+
+void ReportRing::CountDropped()
+{
+    Word(RING_DROPPED).fetch_add(1, std::memory_order_relaxed);
+}
+
+void ReportRing::SetState(RingState state)
+{
+    Word(RING_STATE).store(state, std::memory_order_release);
+}
+
+/**
+ * Free a report which was never delivered to javascript
+ */
+static void discard_report(ReadCallbackContext *context, ReadCallbackProps *data)
+{
+    context->_hidHandle->stats.add(STAT_REPORTS_DROPPED, data->offsets.empty() ? 1 : data->offsets.size() - 1);
+
+    if (data->buf)
+    {
+        context->pool->Release(data->buf);
+    }
+    delete data;
+}
+
+static void deliver_report(Napi::Env env, Napi::Function callback, Context *context, DataType *data);
+
+void ReadCallback(Napi::Env env, Napi::Function callback, Context *context, DataType *data)
+{
+    if (data == &drainSignal)
+    {
+        std::deque<ReadCallbackProps *> reports;
+        {
+            std::unique_lock<std::mutex> lk(context->pendingLock);
+            reports.swap(context->pending);
+            context->drainScheduled = false;
+        }
+        context->pendingSpace.notify_all();
+
+        for (auto report : reports)
+        {
+            deliver_report(env, callback, context, report);
+        }
+    }
+    else if (data == &readySignal)
+    {
+        if (env != nullptr)
+        {
+            context->state->ready = true;
+            for (auto job : context->state->afterReady)
+            {
+                context->_hidHandle->QueueJob(env, job);
+            }
+            context->state->afterReady.clear();
+        }
+    }
+    else
+    {
+        deliver_report(env, callback, context, data);
+    }
+}
+
+// receivedAt goes out as a double, as BigInt needs a newer N-API version than we target.
+// It is exact for the first 2^53 ns of uptime, and rounded to a few ns after that.
+static void deliver_report(Napi::Env env, Napi::Function callback, Context *context, DataType *data)
+{
+    if (env != nullptr && callback != nullptr) //&& context != nullptr)
+    {
+        if (data == nullptr)
+        {
+            auto error = Napi::String::New(env, context->error != "" ? context->error : "could not read from HID device");
+
+            callback.Call({error, env.Null()});
+        }
+        else if (data->command >= 0)
+        {
+            context->_hidHandle->stats.record(STAT_CALLBACK_LAG, monotonicNow() - data->queuedAt);
+
+            Napi::Buffer<unsigned char> buffer;
+            if (data->message.empty())
+            {
+                buffer = Napi::Buffer<unsigned char>::New(env, 0);
+            }
+            else
+            {
+                // Hand the message to the Buffer without copying it
+                auto message = new std::vector<unsigned char>(std::move(data->message));
+                buffer = Napi::Buffer<unsigned char>::New(
+                    env, message->data(), message->size(), [](Napi::Env, unsigned char *, std::vector<unsigned char> *message)
+                    { delete message; },
+                    message);
+            }
+
+            callback.Call({env.Null(), buffer, env.Undefined(), env.Undefined(), Napi::Number::New(env, data->command),
+                           Napi::Number::New(env, (double)data->receivedAt), Napi::Number::New(env, (double)data->sequence)});
+        }
+        else if (data->transaction != 0)
+        {
+            auto buffer = WrapPooledBuffer(env, context->pool, data->buf, data->len);
+            // buf is now owned by the Buffer
+            data->buf = nullptr;
+
+            context->state->transactions.resolve(data->transaction, buffer);
+        }
+        else if (context->decoder)
+        {
+            context->_hidHandle->stats.record(STAT_CALLBACK_LAG, monotonicNow() - data->queuedAt);
+
+            if (context->values.IsEmpty())
+            {
+                auto values = Napi::Int32Array::New(env, context->decoder->size());
+                context->valuesData = values.Data();
+                context->values = Napi::Persistent(values);
+            }
+
+            int reportId = context->numberedReports ? data->buf[0] : 0;
+            context->decoder->decode(data->buf, data->len, context->valuesData);
+
+            auto buffer = WrapPooledBuffer(env, context->pool, data->buf, data->len);
+            // buf is now owned by the Buffer
+            data->buf = nullptr;
+
+            callback.Call({env.Null(), buffer, env.Undefined(), context->values.Value(), Napi::Number::New(env, reportId),
+                           Napi::Number::New(env, (double)data->receivedAt), Napi::Number::New(env, (double)data->sequence)});
+        }
+        else
+        {
+            context->_hidHandle->stats.record(STAT_CALLBACK_LAG, monotonicNow() - data->queuedAt);
+
+            int reportId = context->numberedReports ? data->buf[0] : 0;
+
+            auto buffer = WrapPooledBuffer(env, context->pool, data->buf, data->len);
+            // buf is now owned by the Buffer
+            data->buf = nullptr;
+
+            if (data->offsets.empty())
+            {
+                callback.Call({env.Null(), buffer, env.Undefined(), env.Undefined(), Napi::Number::New(env, reportId),
+                               Napi::Number::New(env, (double)data->receivedAt), Napi::Number::New(env, (double)data->sequence)});
+            }
+            else
+            {
+                auto offsets = Napi::Uint32Array::New(env, data->offsets.size());
+                std::copy(data->offsets.begin(), data->offsets.end(), offsets.Data());
+
+                // The time and sequence number of each report, interleaved
+                auto stamps = Napi::Float64Array::New(env, data->stamps.size());
+                std::copy(data->stamps.begin(), data->stamps.end(), stamps.Data());
+
+                callback.Call({env.Null(), buffer, offsets, env.Undefined(), env.Undefined(), stamps});
+            }
+        }
+    }
+
+    if (data != nullptr)
+    {
+        context->_hidHandle->stats.callbackDone();
+
+        if (data->buf != nullptr)
+        {
+            context->pool->Release(data->buf);
+        }
+        delete data;
+    }
+};
+
+std::string parseReadOptions(const Napi::Value &val, ReadOptions &options)
+{
+    if (val.IsUndefined() || val.IsNull())
+    {
+        return "";
+    }
+    if (!val.IsObject())
+    {
+        return "read options must be an object";
+    }
+
+    Napi::Object obj = val.As<Napi::Object>();
+
+    Napi::Value batchSize = obj.Get("batchSize");
+    if (!batchSize.IsUndefined())
+    {
+        double value = batchSize.IsNumber() ? batchSize.As<Napi::Number>().DoubleValue() : 0;
+        if (!(value >= 1) || value != std::floor(value))
+        {
+            return "batchSize must be a positive integer";
+        }
+        options.batchSize = value > READ_MAX_BATCH_SIZE ? READ_MAX_BATCH_SIZE : (int)value;
+    }
+
+    Napi::Value batchTimeout = obj.Get("batchTimeout");
+    if (!batchTimeout.IsUndefined())
+    {
+        if (!batchTimeout.IsNumber() || batchTimeout.As<Napi::Number>().Int32Value() < 0)
+        {
+            return "batchTimeout must be a non-negative integer";
+        }
+        options.batchTimeout = batchTimeout.As<Napi::Number>().Int32Value();
+    }
+
+    Napi::Value maxQueue = obj.Get("maxQueue");
+    if (!maxQueue.IsUndefined())
+    {
+        if (!maxQueue.IsNumber() || maxQueue.As<Napi::Number>().Int32Value() < 0)
+        {
+            return "maxQueue must be a non-negative integer";
+        }
+        options.maxQueue = maxQueue.As<Napi::Number>().Int32Value();
+    }
+
+    Napi::Value overflow = obj.Get("overflow");
+    if (!overflow.IsUndefined())
+    {
+        std::string policy = overflow.IsString() ? overflow.As<Napi::String>().Utf8Value() : "";
+        if (policy == "block")
+        {
+            options.overflow = READ_OVERFLOW_BLOCK;
+        }
+        else if (policy == "drop-oldest")
+        {
+            options.overflow = READ_OVERFLOW_DROP_OLDEST;
+        }
+        else if (policy == "drop-newest")
+        {
+            options.overflow = READ_OVERFLOW_DROP_NEWEST;
+        }
+        else if (policy == "coalesce")
+        {
+            options.overflow = READ_OVERFLOW_COALESCE;
+        }
+        else
+        {
+            return "overflow must be one of 'block', 'drop-oldest', 'drop-newest' or 'coalesce'";
+        }
+    }
+
+    Napi::Value reportIds = obj.Get("reportIds");
+    if (!reportIds.IsUndefined() && !reportIds.IsNull())
+    {
+        std::string idsError = parseReportIds(reportIds, options.reportIds);
+        if (idsError != "")
+        {
+            return idsError;
+        }
+        options.filterReportIds = true;
+    }
+
+    Napi::Value changesOnly = obj.Get("changesOnly");
+    if (!changesOnly.IsUndefined())
+    {
+        if (!changesOnly.IsBoolean())
+        {
+            return "changesOnly must be a boolean";
+        }
+        options.changesOnly = changesOnly.As<Napi::Boolean>().Value();
+    }
+
+    Napi::Value changeMask = obj.Get("changeMask");
+    if (!changeMask.IsUndefined() && !changeMask.IsNull())
+    {
+        std::string maskError = copyArrayOrBufferIntoVector(changeMask, options.changeMask);
+        if (maskError != "")
+        {
+            return "changeMask must be an array of bytes or a Buffer";
+        }
+        options.changesOnly = true;
+    }
+
+    Napi::Value maxRate = obj.Get("maxRate");
+    if (!maxRate.IsUndefined())
+    {
+        // Tiny rates would overflow the interval between reports
+        double value = maxRate.IsNumber() ? maxRate.As<Napi::Number>().DoubleValue() : -1;
+        if (!(value == 0 || value >= READ_MIN_MAX_RATE))
+        {
+            return "maxRate must be 0 or at least 0.001";
+        }
+        options.maxRate = value;
+    }
+
+    Napi::Value ring = obj.Get("ring");
+    if (!ring.IsUndefined() && !ring.IsNull())
+    {
+        if (!ring.IsTypedArray() || ring.As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array)
+        {
+            return "ring must be a Uint8Array";
+        }
+        auto ringArray = ring.As<Napi::Uint8Array>();
+        if (ringArray.ByteOffset() % 4 != 0)
+        {
+            return "ring must start on a 4 byte boundary";
+        }
+        options.ringData = ringArray.Data();
+        options.ringLength = ringArray.ByteLength();
+        options.ring = std::make_shared<Napi::ObjectReference>(Napi::Persistent(ring.As<Napi::Object>()));
+    }
+
+    Napi::Value latest = obj.Get("latest");
+    if (!latest.IsUndefined())
+    {
+        if (!latest.IsBoolean())
+        {
+            return "latest must be a boolean";
+        }
+        options.latest = latest.As<Napi::Boolean>().Value();
+    }
+
+    Napi::Value framer = obj.Get("framer");
+    if (!framer.IsUndefined() && !framer.IsNull())
+    {
+        std::string framerError = parseFramerConfig(framer, options.framer);
+        if (framerError != "")
+        {
+            return framerError;
+        }
+        options.framing = true;
+    }
+
+    Napi::Value decode = obj.Get("decode");
+    if (!decode.IsUndefined())
+    {
+        if (!decode.IsBoolean())
+        {
+            return "decode must be a boolean";
+        }
+        options.decode = decode.As<Napi::Boolean>().Value();
+    }
+
+    if (options.overflow == READ_OVERFLOW_COALESCE && options.batchSize > 1)
+    {
+        return "overflow 'coalesce' cannot be used with batchSize";
+    }
+    if (options.decode && options.batchSize > 1)
+    {
+        return "decode cannot be used with batchSize";
+    }
+    if (options.maxRate > 0 && options.batchSize > 1)
+    {
+        return "maxRate cannot be used with batchSize";
+    }
+    if (options.ringData && (options.batchSize > 1 || options.decode || options.maxRate > 0))
+    {
+        return "ring cannot be used with batchSize, decode or maxRate";
+    }
+    if (options.latest && (options.batchSize > 1 || options.decode || options.maxRate > 0 || options.ringData))
+    {
+        return "latest cannot be used with batchSize, decode, maxRate or ring";
+    }
+    if (options.framing && (options.batchSize > 1 || options.decode || options.maxRate > 0 || options.ringData || options.latest || options.overflow == READ_OVERFLOW_COALESCE))
+    {
+        return "framer cannot be used with batchSize, decode, maxRate, ring, latest or overflow 'coalesce'";
+    }
+
+    return "";
+}
+
+std::string parseReportIds(const Napi::Value &val, std::vector<unsigned char> &ids)
+{
+    if (!val.IsArray())
+    {
+        return "reportIds must be an array of report ids";
+    }
+
+    Napi::Array arr = val.As<Napi::Array>();
+    ids.clear();
+    ids.reserve(arr.Length());
+    for (uint32_t i = 0; i < arr.Length(); i++)
+    {
+        Napi::Value id = arr.Get(i);
+        if (!id.IsNumber() || id.As<Napi::Number>().Int32Value() < 0 || id.As<Napi::Number>().Int32Value() > 255)
+        {
+            return "reportIds must be numbers from 0 to 255";
+        }
+        ids.push_back((unsigned char)id.As<Napi::Number>().Int32Value());
+    }
+
+    return "";
+}
+
+bool ReadThreadState::is_running()
+{
+    std::unique_lock<std::mutex> lk(lock);
+    return running;
+}
+void ReadThreadState::wait()
+{
+    std::unique_lock<std::mutex> lk(lock);
+    if (running)
+    {
+        wait_for_end.wait(lk, [this]
+                          { return !running; });
+    }
+}
+
+void ReadThreadState::stop()
+{
+    abort = true;
+
+    std::unique_lock<std::mutex> lk(lock);
+    if (reader)
+    {
+        reader->Interrupt();
+    }
+    if (queueSpace)
+    {
+        // Taken so that this can't fall between a waiting read checking abort and starting to wait
+        std::unique_lock<std::mutex> queueLk(*queueLock);
+        queueSpace->notify_all();
+    }
+}
+
+void ReadThreadState::set_queue(std::mutex *newQueueLock, std::condition_variable *newQueueSpace)
+{
+    std::unique_lock<std::mutex> lk(lock);
+    queueLock = newQueueLock;
+    queueSpace = newQueueSpace;
+}
+
+void ReadThreadState::set_reader(InterruptibleReader *newReader)
+{
+    std::unique_lock<std::mutex> lk(lock);
+    reader = newReader;
+
+    // stop() may have been called before there was a reader to wake
+    if (reader && abort)
+    {
+        reader->Interrupt();
+    }
+}
+
+void TransactionTable::add(uint32_t id, size_t offset, std::vector<unsigned char> expected, Napi::Promise::Deferred deferred)
+{
+    promises.emplace(id, deferred);
+
+    std::unique_lock<std::mutex> lk(lock);
+    pending.push_back({id, offset, std::move(expected)});
+    pendingCount = pending.size();
+}
+
+uint32_t TransactionTable::match(const unsigned char *report, size_t length)
+{
+    if (pendingCount == 0)
+    {
+        return 0;
+    }
+
+    std::unique_lock<std::mutex> lk(lock);
+    for (auto it = pending.begin(); it != pending.end(); it++)
+    {
+        if (it->offset + it->expected.size() <= length && std::equal(it->expected.begin(), it->expected.end(), report + it->offset))
+        {
+            uint32_t id = it->id;
+            pending.erase(it);
+            pendingCount = pending.size();
+            return id;
+        }
+    }
+
+    return 0;
+}
+
+void TransactionTable::resolve(uint32_t id, Napi::Value reply)
+{
+    auto it = promises.find(id);
+    if (it != promises.end())
+    {
+        it->second.Resolve(reply);
+        promises.erase(it);
+    }
+}
+
+void TransactionTable::reject(uint32_t id, const std::string &message)
+{
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        auto it = std::find_if(pending.begin(), pending.end(), [id](const Pending &p)
+                               { return p.id == id; });
+        if (it != pending.end())
+        {
+            pending.erase(it);
+            pendingCount = pending.size();
+        }
+    }
+
+    auto it = promises.find(id);
+    if (it != promises.end())
+    {
+        it->second.Reject(Napi::Error::New(it->second.Env(), message).Value());
+        promises.erase(it);
+    }
+}
+
+void TransactionTable::rejectAll(const std::string &message)
+{
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        pending.clear();
+        pendingCount = 0;
+    }
+
+    for (auto &it : promises)
+    {
+        it.second.Reject(Napi::Error::New(it.second.Env(), message).Value());
+    }
+    promises.clear();
+}
+
+void ReadThreadState::release()
+{
+    std::unique_lock<std::mutex> lk(lock);
+    running = false;
+    reader = nullptr;
+    queueLock = nullptr;
+    queueSpace = nullptr;
+    wait_for_end.notify_all();
+}
+
+/**
+ * Check whether a report which has just been read should be passed on to javascript, counting it if not
+ */
+static bool accept_report(ReadCallbackContext *context, const unsigned char *buf, int len)
+{
+    unsigned char reportId = context->numberedReports ? buf[0] : 0;
+
+    if (!context->state->reportFilter.accepts(reportId))
+    {
+        context->_hidHandle->stats.add(STAT_REPORTS_FILTERED);
+        return false;
+    }
+
+    if (context->changeFilter && !context->changeFilter->changed(reportId, buf, len))
+    {
+        context->_hidHandle->stats.add(STAT_REPORTS_UNCHANGED);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Check whether a report is the reply to a transaction, and if so pass a copy of it straight to the event loop, bypassing the queue and its overflow policy
+ */
+static bool match_transaction(ReadCallbackContext *context, const unsigned char *buf, int len)
+{
+    uint32_t id = context->state->transactions.match(buf, len);
+    if (id == 0)
+    {
+        return false;
+    }
+
+    auto data = new ReadCallbackProps;
+    data->buf = context->pool->Acquire();
+    memcpy(data->buf, buf, len);
+    data->len = len;
+    data->receivedAt = context->reader->ReceivedAt();
+    data->sequence = context->reader->Sequence();
+    data->transaction = id;
+    data->queuedAt = monotonicNow();
+
+    context->_hidHandle->stats.callbackQueued();
+    context->read_callback.BlockingCall(data);
+    return true;
+}
+
+/**
+ * Collect any further reports which arrive within the batch window, appending them to data.
+ * An error here ends the batch early, and will be reported by the next read of the main loop
+ */
+static void fill_batch(ReadCallbackContext *context, ReadCallbackProps *data, int batchTimeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(batchTimeout);
+
+    while (data->offsets.size() < (size_t)context->options.batchSize && !context->state->abort)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+
+        int len = context->reader->Read(data->buf + data->len, context->reportSize, remaining > 0 ? (int)remaining : 0);
+        if (len <= 0)
+        {
+            break;
+        }
+        if (match_transaction(context, data->buf + data->len, len) || !accept_report(context, data->buf + data->len, len))
+        {
+            continue;
+        }
+
+        data->offsets.push_back(data->len);
+        data->len += len;
+        data->stamps.push_back(context->reader->ReceivedAt());
+        data->stamps.push_back(context->reader->Sequence());
+    }
+
+    data->offsets.push_back(data->len);
+}
+
+/**
+ * Whether two reports have the same report id, for READ_OVERFLOW_COALESCE
+ */
+static bool same_report_id(ReadCallbackContext *context, ReadCallbackProps *a, ReadCallbackProps *b)
+{
+    return !context->numberedReports || a->buf[0] == b->buf[0];
+}
+
+/**
+ * Add a report to the pending queue, applying the overflow policy when it is full, and make sure that javascript will be called to collect it
+ */
+static void queue_report(ReadCallbackContext *context, ReadCallbackProps *data)
+{
+    auto &options = context->options;
+    auto &stats = context->_hidHandle->stats;
+
+    ReadCallbackProps *dropped = nullptr;
+    bool schedule = false;
+    {
+        std::unique_lock<std::mutex> lk(context->pendingLock);
+        auto &pending = context->pending;
+
+        if (options.overflow == READ_OVERFLOW_COALESCE)
+        {
+            auto it = std::find_if(pending.begin(), pending.end(), [&](ReadCallbackProps *other)
+                                   { return same_report_id(context, data, other); });
+            if (it != pending.end())
+            {
+                dropped = *it;
+                pending.erase(it);
+                stats.callbackDone();
+            }
+        }
+
+        if (!dropped && options.maxQueue > 0 && pending.size() >= (size_t)options.maxQueue)
+        {
+            switch (options.overflow)
+            {
+            case READ_OVERFLOW_BLOCK:
+                // stop() also signals pendingSpace, so that a stop request is noticed straight away
+                context->pendingSpace.wait(lk, [context, &pending, &options]
+                                           { return pending.size() < (size_t)options.maxQueue || context->state->abort; });
+                if (context->state->abort)
+                {
+                    dropped = data;
+                    data = nullptr;
+                }
+                break;
+            case READ_OVERFLOW_DROP_NEWEST:
+                dropped = data;
+                data = nullptr;
+                break;
+            case READ_OVERFLOW_DROP_OLDEST:
+            case READ_OVERFLOW_COALESCE:
+                dropped = pending.front();
+                pending.pop_front();
+                stats.callbackDone();
+                break;
+            }
+        }
+
+        if (data)
+        {
+            data->queuedAt = monotonicNow();
+            pending.push_back(data);
+            stats.callbackQueued();
+
+            schedule = !context->drainScheduled;
+            context->drainScheduled = true;
+        }
+    }
+
+    if (dropped)
+    {
+        discard_report(context, dropped);
+    }
+
+    if (schedule)
+    {
+        context->read_callback.BlockingCall(&drainSignal);
+    }
+}
+
+/**
+ * Pass a report which has been read into buf on to javascript, first collecting a batch if enabled.
+ * Ownership of buf is taken
+ */
+static void dispatch_report(ReadCallbackContext *context, unsigned char *buf, int len, uint64_t receivedAt, uint64_t sequence, int batchTimeout)
 {
-    unsigned char *buf;
-    int len;
-};
+    auto data = new ReadCallbackProps;
+    data->buf = buf;
+    data->len = len;
+    data->receivedAt = receivedAt;
+    data->sequence = sequence;
 
-using Context = ReadCallbackContext;
-using DataType = ReadCallbackProps;
-void ReadCallback(Napi::Env env, Napi::Function callback, Context *context, DataType *data);
-using TSFN = Napi::TypedThreadSafeFunction<Context, DataType, ReadCallback>;
-using FinalizerDataType = void;
+    if (context->options.batchSize > 1)
+    {
+        data->offsets.reserve(context->options.batchSize + 1);
+        data->offsets.push_back(0);
+        data->stamps.reserve(context->options.batchSize * 2);
+        data->stamps.push_back(receivedAt);
+        data->stamps.push_back(sequence);
 
-struct ReadCallbackContext
+        fill_batch(context, data, batchTimeout);
+    }
+
+    queue_report(context, data);
+}
+
+/**
+ * Record a report which has been accepted as the latest for its report id, for getLatestReport
+ */
+static void store_latest(ReadCallbackContext *context, const unsigned char *buf, int len)
 {
-    std::shared_ptr<ReadThreadState> state;
+    unsigned char reportId = context->numberedReports ? buf[0] : 0;
+    context->_hidHandle->latest.store(reportId, buf, len, context->reader->ReceivedAt(), context->reader->Sequence());
+}
 
-    std::shared_ptr<DeviceContext> _hidHandle;
-    std::thread read_thread;
+/**
+ * Add a report which has been accepted to the message being reassembled, passing the message on to javascript once it is complete
+ */
+static void frame_report(ReadCallbackContext *context, const unsigned char *buf, int len)
+{
+    auto &stats = context->_hidHandle->stats;
 
-    TSFN read_callback;
-};
+    // The report id is not part of the packet
+    int skip = context->numberedReports ? 1 : 0;
+    FrameResult result = len > skip ? context->reassembler->feed(buf + skip, len - skip) : FRAME_IGNORED;
+    stats.add(STAT_FRAMING_ERRORS, context->reassembler->takeErrors());
+    if (result != FRAME_COMPLETE)
+    {
+        return;
+    }
 
-void ReadCallback(Napi::Env env, Napi::Function callback, Context *context, DataType *data)
+    stats.add(STAT_MESSAGES_READ);
+
+    auto data = new ReadCallbackProps;
+    data->buf = nullptr;
+    data->len = 0;
+    // The time and sequence number of the last packet, which completed the message
+    data->receivedAt = context->reader->ReceivedAt();
+    data->sequence = context->reader->Sequence();
+    data->command = context->reassembler->command();
+    data->message = context->reassembler->take();
+
+    queue_report(context, data);
+}
+
+/**
+ * Apply maxRate to a report which has been accepted, holding it back when another with the same id was delivered too recently.
+ * Any report already held for the id is replaced, as only the latest is delivered.
+ * Returns true if ownership of buf has been taken
+ */
+static bool hold_report(ReadCallbackContext *context, unsigned char *buf, int len)
 {
-    if (env != nullptr && callback != nullptr) //&& context != nullptr)
+    if (!context->rateLimiter)
     {
-        if (data == nullptr)
+        return false;
+    }
+
+    unsigned char reportId = context->numberedReports ? buf[0] : 0;
+    auto &held = context->held[reportId];
+    if (held.buf)
+    {
+        context->pool->Release(held.buf);
+        context->_hidHandle->stats.add(STAT_REPORTS_DECIMATED);
+        held.buf = nullptr;
+        context->heldCount--;
+    }
+
+    if (context->rateLimiter->allow(reportId, monotonicNow()))
+    {
+        return false;
+    }
+
+    held.buf = buf;
+    held.len = len;
+    held.receivedAt = context->reader->ReceivedAt();
+    held.sequence = context->reader->Sequence();
+    context->heldCount++;
+    return true;
+}
+
+/**
+ * Deliver any held reports which are now allowed by maxRate.
+ * Returns how many milliseconds until the next of the rest is due, or -1 if nothing is held
+ */
+static int flush_held_reports(ReadCallbackContext *context)
+{
+    if (context->heldCount == 0)
+    {
+        return -1;
+    }
+
+    uint64_t now = monotonicNow();
+    uint64_t nextDue = UINT64_MAX;
+    for (int reportId = 0; reportId < 256; reportId++)
+    {
+        auto &held = context->held[reportId];
+        if (!held.buf)
         {
-            auto error = Napi::String::New(env, "could not read from HID device");
+            continue;
+        }
 
-            callback.Call({error, env.Null()});
+        if (context->rateLimiter->allow(reportId, now))
+        {
+            unsigned char *buf = held.buf;
+            held.buf = nullptr;
+            context->heldCount--;
+            dispatch_report(context, buf, held.len, held.receivedAt, held.sequence, 0);
         }
         else
         {
-            auto buffer = Napi::Buffer<unsigned char>::Copy(env, data->buf, data->len);
-
-            callback.Call({env.Null(), buffer});
+            nextDue = std::min(nextDue, context->rateLimiter->nextAllowed(reportId));
         }
     }
 
-    if (data != nullptr)
+    if (nextDue == UINT64_MAX)
     {
-        delete data->buf;
-        delete data;
+        return -1;
     }
-};
+    // Round up, so that the report is due once the wait is over. Clamped, as a negative wait would be treated as waiting forever
+    uint64_t wait = nextDue > now ? (nextDue - now + 999999) / 1000000 : 0;
+    return wait > INT_MAX ? INT_MAX : (int)wait;
+}
 
-bool ReadThreadState::is_running()
+/**
+ * Use the report descriptor to determine how large a buffer is needed to read any input report from the device, and to build the decoder when decoding.
+ * Without a descriptor, reports are assumed to start with a report id
+ */
+static void load_report_descriptor(ReadCallbackContext *context)
 {
-    std::unique_lock<std::mutex> lk(lock);
-    return running;
+    std::vector<unsigned char> descriptor;
+    ReportDescriptor parsed;
+    if (getReportDescriptor(context->_hidHandle->hid, descriptor) != "" || parseReportDescriptor(descriptor.data(), descriptor.size(), parsed) != "")
+    {
+        return;
+    }
+
+    size_t len = parsed.maxInputReportLength();
+    if (len > 0)
+    {
+        context->reportSize = std::min<size_t>(std::max<size_t>(len, READ_BUFF_MINSIZE), READ_BUFF_MAXSIZE);
+        context->numberedReports = parsed.numbered;
+    }
+
+    if (context->options.decode)
+    {
+        context->decoder.reset(new ReportDecoder(parsed));
+    }
 }
-void ReadThreadState::wait()
+
+static void begin_read(ReadCallbackContext *context)
 {
-    std::unique_lock<std::mutex> lk(lock);
-    if (running)
+    load_report_descriptor(context);
+    context->pool = new ReportBufferPool(context->reportSize * context->options.batchSize);
+
+    context->reader = new InterruptibleReader(context->_hidHandle->hid, &context->_hidHandle->stats);
+    context->state->set_reader(context->reader);
+
+    auto &options = context->options;
+    if (options.changesOnly)
     {
-        wait_for_end.wait(lk, [this]
-                          { return !running; });
+        context->changeFilter.reset(new ChangeFilter(options.changeMask));
+    }
+    if (options.maxRate > 0)
+    {
+        context->rateLimiter.reset(new RateLimiter((uint64_t)(1e9 / options.maxRate)));
+    }
+    if (options.ringData)
+    {
+        context->ring.reset(new ReportRing(options.ringData, options.ringLength));
+    }
+    if (options.framing)
+    {
+        context->reassembler.reset(new Reassembler(options.framer));
     }
 }
 
-void ReadThreadState::release()
+static void end_read(ReadCallbackContext *context)
 {
-    std::unique_lock<std::mutex> lk(lock);
-    running = false;
-    wait_for_end.notify_all();
+    context->state->set_reader(nullptr);
+    delete context->reader;
+    context->reader = nullptr;
+
+    // Once the state is released the context may be freed, so take copies of what is needed
+    auto state = context->state;
+    auto read_callback = context->read_callback;
+
+    // Mark the state and used hidHandle as released
+    state->release();
+
+    // Cleanup the function
+    read_callback.Release();
+}
+
+/**
+ * Read reports straight into the slots of the ring, without involving javascript at all unless there is an error.
+ * When the ring is full, new reports are discarded
+ */
+static void read_into_ring(ReadCallbackContext *context)
+{
+    auto ring = context->ring.get();
+    auto &stats = context->_hidHandle->stats;
+
+    if (!ring->Init(context->reportSize))
+    {
+        ring->SetState(RING_STATE_ERROR);
+        context->error = "ring is too small to hold a report from this device";
+        context->read_callback.BlockingCall(nullptr);
+        return;
+    }
+
+    // Somewhere to read to while the ring is full
+    unsigned char *scratch = context->pool->Acquire();
+
+    while (!context->state->abort)
+    {
+        unsigned char *slot = ring->NextSlot();
+        unsigned char *buf = slot ? slot : scratch;
+
+        int len = context->reader->Read(buf, context->reportSize, -1);
+        if (context->state->abort)
+            break;
+
+        if (len < 0)
+        {
+            // Emit and error and stop reading
+            ring->SetState(RING_STATE_ERROR);
+            context->read_callback.BlockingCall(nullptr);
+            context->pool->Release(scratch);
+            return;
+        }
+        if (len == 0 || match_transaction(context, buf, len) || !accept_report(context, buf, len))
+        {
+            continue;
+        }
+
+        if (!slot)
+        {
+            // The consumer may have caught up while reading
+            slot = ring->NextSlot();
+            if (!slot)
+            {
+                ring->CountDropped();
+                stats.add(STAT_REPORTS_DROPPED);
+                continue;
+            }
+            memcpy(slot, scratch, len);
+        }
+        ring->Publish(len, context->reader->ReceivedAt(), context->reader->Sequence());
+    }
+
+    ring->SetState(RING_STATE_STOPPED);
+    context->pool->Release(scratch);
+}
+
+static void read_thread_main(ReadCallbackContext *context)
+{
+    if (!context->reader)
+    {
+        begin_read(context);
+    }
+
+    if (context->options.decode && !context->decoder)
+    {
+        context->error = "could not decode reports, as the report descriptor could not be read";
+        context->read_callback.BlockingCall(nullptr);
+        end_read(context);
+        return;
+    }
+
+    context->read_callback.BlockingCall(&readySignal);
+
+    if (context->ring)
+    {
+        read_into_ring(context);
+        end_read(context);
+        return;
+    }
+
+    unsigned char *buf = context->pool->Acquire();
+    // How long to wait for a report, so that reports held back by maxRate are delivered on time
+    int timeout = -1;
+
+    while (!context->state->abort)
+    {
+        int len = context->reader->Read(buf, context->reportSize, timeout);
+        if (context->state->abort)
+            break;
+
+        if (len < 0)
+        {
+            // Emit and error and stop reading
+            context->read_callback.BlockingCall(nullptr);
+            break;
+        }
+        else if (len > 0 && !match_transaction(context, buf, len) && accept_report(context, buf, len))
+        {
+            if (context->options.latest)
+            {
+                // buf is only copied, so can be read into again
+                store_latest(context, buf, len);
+                continue;
+            }
+            if (context->reassembler)
+            {
+                frame_report(context, buf, len);
+                continue;
+            }
+
+            if (!hold_report(context, buf, len))
+            {
+                dispatch_report(context, buf, len, context->reader->ReceivedAt(), context->reader->Sequence(), context->options.batchTimeout);
+            }
+            // buf is now owned by ReadCallback, or held until it can be delivered
+            buf = context->pool->Acquire();
+        }
+
+        timeout = flush_held_reports(context);
+    }
+
+    context->pool->Release(buf);
+    for (auto &held : context->held)
+    {
+        if (held.buf)
+        {
+            context->pool->Release(held.buf);
+        }
+    }
+
+    end_read(context);
+}
+
+#ifdef NODE_HID_HIDRAW
+
+// How many reports to read from a device each time it is readable, so that a busy device doesn't starve the others on its thread
+#define REACTOR_MAX_REPORTS_PER_WAKE 16
+
+/**
+ * Reads a device from one of the threads of the shared reactor, instead of a dedicated thread.
+ * This only reads the reports which are already waiting, so batchTimeout is not used
+ */
+class ReactorReadSource : public ReactorSource
+{
+public:
+    ReactorReadSource(ReadCallbackContext *context) : context(context) {}
+
+    bool OnAttach() override
+    {
+        // Reading the descriptor and opening the device can be slow, so this is done here rather than on the javascript thread
+        begin_read(context);
+        if (context->reader->Fd() < 0 || (context->options.decode && !context->decoder))
+        {
+            // Hand over to a dedicated thread instead, which will report any error
+            std::unique_lock<std::mutex> lk(context->threadLock);
+            context->reactor = nullptr;
+            context->read_thread = std::thread(read_thread_main, context);
+            handedOver = true;
+            return false;
+        }
+
+        SetFds(context->reader->Fd(), context->reader->WakeFd());
+        return true;
+    }
+
+    bool OnReadable() override
+    {
+        // The first time, also collect everything that hidapi queued before we were watching, as that won't cause another wake
+        int limit = first ? INT_MAX : REACTOR_MAX_REPORTS_PER_WAKE;
+        if (first)
+        {
+            context->read_callback.BlockingCall(&readySignal);
+            first = false;
+        }
+
+        for (int i = 0; i < limit && !context->state->abort; i++)
+        {
+            unsigned char *buf = context->pool->Acquire();
+            int len = context->reader->Read(buf, context->reportSize, 0);
+            if (len <= 0)
+            {
+                context->pool->Release(buf);
+                if (len < 0)
+                {
+                    // Emit and error and stop reading
+                    context->read_callback.BlockingCall(nullptr);
+                    return false;
+                }
+                break;
+            }
+
+            if (match_transaction(context, buf, len) || !accept_report(context, buf, len))
+            {
+                context->pool->Release(buf);
+                continue;
+            }
+            if (context->options.latest || context->reassembler)
+            {
+                if (context->reassembler)
+                    frame_report(context, buf, len);
+                else
+                    store_latest(context, buf, len);
+                context->pool->Release(buf);
+                continue;
+            }
+
+            dispatch_report(context, buf, len, context->reader->ReceivedAt(), context->reader->Sequence(), 0);
+        }
+
+        return !context->state->abort;
+    }
+
+    void OnDetached() override
+    {
+        if (handedOver)
+        {
+            delete this;
+            return;
+        }
+
+        if (!IsWatched() || HasFailed())
+        {
+            context->error = "could not watch the device for reports";
+            context->read_callback.BlockingCall(nullptr);
+        }
+        end_read(context);
+        delete this;
+    }
+
+private:
+    ReadCallbackContext *context;
+    bool first = true;
+    bool handedOver = false;
+};
+
+/**
+ * Attempt to hand the reading of this context over to the reactor.
+ * Returns false if the device is not able to be read this way
+ */
+static bool start_reactor_read(ReadCallbackContext *context, std::shared_ptr<ReadReactor> reactor)
+{
+    if (context->options.maxQueue > 0 && context->options.overflow == READ_OVERFLOW_BLOCK)
+    {
+        // Waiting for space would hold up every other device on the same reactor thread
+        return false;
+    }
+    if (context->options.maxRate > 0 || context->options.ringData)
+    {
+        // Held reports need a timer to deliver them, which only the read thread has, and a ring is best served by its own thread
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lk(context->threadLock);
+    context->reactor = reactor;
+    auto source = new ReactorReadSource(context);
+    if (!reactor->Add(source))
+    {
+        context->reactor = nullptr;
+        delete source;
+        return false;
+    }
+
+    return true;
+}
+
+#endif
+
+Napi::Value setReadReactorThreads(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    void *data = info.Data();
+    if (!data)
+    {
+        Napi::TypeError::New(env, "setReadReactorThreads missing context").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    ContextState *context = (ContextState *)data;
+
+    if (info.Length() != 1 || !info[0].IsNumber() || !(info[0].As<Napi::Number>().DoubleValue() >= 0))
+    {
+        Napi::TypeError::New(env, "need a non-negative number of threads in setReadReactorThreads").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    // Too many threads is reported by the ApplicationContext, so only avoid the conversion overflowing
+    double threads = info[0].As<Napi::Number>().DoubleValue();
+    std::string error = context->appCtx->setReadReactorThreads(threads > INT_MAX ? INT_MAX : (int)threads);
+    if (error != "")
+    {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    return env.Null();
 }
 
 /**
  * Getting the thread safety of this correct has been challenging.
- * There is a problem that the read thread can take 50ms to exit once run_read becomes false, and we don't want to block the event loop waiting for it.
+ * There is a problem that the read thread can take 50ms to exit once abort becomes true (on backends where a read can't be interrupted), and we don't want to block the event loop waiting for it.
  * And a problem of that either the read_thread can decide to abort by itself.
  * This means that either read_thread or the class that spawned it could outlive the other.
  *
@@ -82,70 +1672,82 @@ void ReadThreadState::release()
  * to both be able to know if the loop is running and to 'ask' it to stop
  *
  * While this does now return a struct to handle the shared state, the tsfn and thread are importantly not on this class.
+ *
+ * When the reactor is enabled, the reads are instead done from one of its shared threads, which performs the same cleanup once the read is stopped.
  */
-std::shared_ptr<ReadThreadState> start_read_helper(Napi::Env env, std::shared_ptr<DeviceContext> hidHandle, Napi::Function callback)
+std::shared_ptr<ReadThreadState> start_read_helper(Napi::Env env, std::shared_ptr<DeviceContext> hidHandle, Napi::Function callback, const ReadOptions &options)
 {
     auto state = std::make_shared<ReadThreadState>();
+    if (options.filterReportIds)
+    {
+        state->reportFilter.acceptOnly(options.reportIds);
+    }
 
     auto context = new ReadCallbackContext;
     context->state = state;
+    state->set_queue(&context->pendingLock, &context->pendingSpace);
     context->_hidHandle = std::move(hidHandle);
-
-    context->read_thread = std::thread([context]()
-                                       {
-                              int mswait = 50;
-                              int len = 0;
-                              unsigned char *buf = new unsigned char[READ_BUFF_MAXSIZE];
-
-                              while (!context->state->abort)
-                              {
-                                len = hid_read_timeout(context->_hidHandle->hid, buf, READ_BUFF_MAXSIZE, mswait);
-                                if (context->state->abort)
-                                    break;
-
-                                if (len < 0)
-                                {
-                                    // Emit and error and stop reading
-                                    context->read_callback.BlockingCall(nullptr);
-                                    break;
-                                }
-                                else if (len > 0)
-                                {
-                                    auto data = new ReadCallbackProps;
-                                    data->buf = buf;
-                                    data->len = len;
-
-                                    context->read_callback.BlockingCall(data);
-                                    // buf is now owned by ReadCallback
-                                    buf = new unsigned char[READ_BUFF_MAXSIZE];
-                                }
-                              }
-
-                              delete[] buf;
-
-                              // Mark the state and used hidHandle as released
-                              context->state->release();
-
-                              // Cleanup the function
-                              context->read_callback.Release(); });
+    context->options = options;
 
     context->read_callback = TSFN::New(
         env,
         callback,                                 // JavaScript function called asynchronously
         "HID:read",                               // Name
-        0,                                        // Unlimited queue
+        0,                                        // Unlimited queue, as reports are queued in pending instead
         1,                                        // Only one thread will use this initially
         context,                                  // Context
         [](Napi::Env, void *, Context *context) { // Finalizer used to clean threads up
-            if (context->read_thread.joinable())
             {
-                // Ensure the thread has terminated
-                context->read_thread.join();
+                std::unique_lock<std::mutex> lk(context->threadLock);
+                if (context->read_thread.joinable())
+                {
+                    // Ensure the thread has terminated
+                    context->read_thread.join();
+                }
+                else if (context->reactor)
+                {
+                    // Ensure the reactor has finished with the context
+                    context->state->stop();
+                    context->state->wait();
+                }
+            }
+
+            // Writes which were waiting for the read to start are never made, and their transactions are rejected below
+            for (auto job : context->state->afterReady)
+            {
+                delete job;
+            }
+            context->state->afterReady.clear();
+
+            // Anything left waiting was never collected
+            for (auto report : context->pending)
+            {
+                context->_hidHandle->stats.callbackDone();
+                discard_report(context, report);
+            }
+            context->state->transactions.rejectAll("reading stopped before a reply was received");
+
+            // Outstanding Buffers may keep the pool alive for longer
+            if (context->pool)
+            {
+                context->pool->Unref();
             }
 
             // Free the context
             delete context;
         });
 
+#ifdef NODE_HID_HIDRAW
+    auto appCtx = ApplicationContext::get();
+    auto reactor = appCtx ? appCtx->getReadReactor() : nullptr;
+    if (reactor && start_reactor_read(context, reactor))
+    {
+        return state;
+    }
+#endif
+
+    // The thread must be started after the tsfn has been created, as it uses the tsfn straight away
+    context->read_thread = std::thread(read_thread_main, context);
+
     return state;
-}
\ No newline at end of file
+}
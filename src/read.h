@@ -2,27 +2,307 @@
 #define NODEHID_READ_H__
 
 #include "util.h"
+#include "framer.h"
 
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <map>
+#include <mutex>
+
+/**
+ * What to do with a report when the queue of callbacks waiting for javascript is full
+ */
+enum ReadOverflow
+{
+    // Stop reading until there is space, leaving the reports to the kernel and device
+    READ_OVERFLOW_BLOCK,
+    // Discard the oldest waiting report to make space
+    READ_OVERFLOW_DROP_OLDEST,
+    // Discard the new report
+    READ_OVERFLOW_DROP_NEWEST,
+    // Replace any waiting report with the same report id, so only the latest of each is delivered. Otherwise the oldest is discarded
+    READ_OVERFLOW_COALESCE,
+};
+
+/**
+ * Options controlling how the read thread delivers reports to javascript.
+ */
+struct ReadOptions
+{
+    // Maximum number of reports delivered in a single callback. 1 disables batching
+    int batchSize = 1;
+    // How long to wait for more reports to fill a batch once the first has arrived, in milliseconds.
+    // 0 only collects the reports which are already pending
+    int batchTimeout = 0;
+    // Maximum number of callbacks waiting for the event loop, beyond which overflow is applied. 0 is unlimited
+    int maxQueue = 0;
+    ReadOverflow overflow = READ_OVERFLOW_BLOCK;
+    // Decode the input fields of each report using the report descriptor, delivering them alongside the report
+    bool decode = false;
+    // Only deliver reports with these ids, when filterReportIds is set
+    bool filterReportIds = false;
+    std::vector<unsigned char> reportIds;
+    // Only deliver a report if it differs from the previous one with the same id, comparing only the bits set in changeMask
+    bool changesOnly = false;
+    std::vector<unsigned char> changeMask;
+    // Deliver at most this many reports per second for each report id, keeping the latest of any held back. 0 is unlimited
+    double maxRate = 0;
+    // When set, reports are written into this memory as a ReportRing instead of being passed to the callback. The reference keeps it alive
+    std::shared_ptr<Napi::ObjectReference> ring;
+    unsigned char *ringData = nullptr;
+    size_t ringLength = 0;
+    // Only keep the latest report of each id in DeviceContext::latest, instead of passing them to the callback
+    bool latest = false;
+    // Reassemble reports into messages with the framer, passing only complete messages to the callback
+    bool framing = false;
+    FramerConfig framer;
+};
+
+// Layout of the header of a ReportRing, in 32 bit words
+#define RING_HEAD 0
+#define RING_TAIL 1
+#define RING_SLOT_COUNT 2
+#define RING_SLOT_SIZE 3
+#define RING_DROPPED 4
+#define RING_STATE 5
+// Size of the header in bytes, after which the slots start
+#define RING_HEADER_SIZE 64
+// Each slot starts with the sequence number and length of its report, then the time it was read as two words, low first
+#define RING_SLOT_HEADER_SIZE 16
+
+enum RingState
+{
+    RING_STATE_STARTING,
+    RING_STATE_RUNNING,
+    RING_STATE_STOPPED,
+    RING_STATE_ERROR,
+};
+
+/**
+ * A single producer, single consumer ring of reports in memory shared with javascript, such as a SharedArrayBuffer.
+ * The header holds the number of reports written (head) and consumed (tail), so the oldest waiting report is in slot tail % slotCount.
+ * The read thread only writes head, and the consumer only writes tail, so neither needs a lock. Each is a free running 32 bit counter
+ */
+class ReportRing
+{
+public:
+    ReportRing(unsigned char *memory, size_t length) : memory(memory), length(length) {}
+
+    /**
+     * Lay out the ring with slots large enough for reportSize bytes, resetting it to empty.
+     * Returns false if not even one slot fits
+     */
+    bool Init(size_t reportSize);
+
+    // Where the next report should be written, or nullptr if the consumer has not yet freed the slot
+    unsigned char *NextSlot();
+    // Make the report written to NextSlot visible to the consumer. Only the low 32 bits of sequence are kept
+    void Publish(size_t len, uint64_t receivedAt, uint64_t sequence);
+
+    // Count a report which was discarded as the ring was full
+    void CountDropped();
+    void SetState(RingState state);
+
+private:
+    std::atomic<uint32_t> &Word(int index) { return reinterpret_cast<std::atomic<uint32_t> *>(memory)[index]; }
+
+    unsigned char *memory;
+    size_t length;
+    uint32_t slotCount = 0;
+    uint32_t slotSize = 0;
+};
+
+/**
+ * Parse a list of report ids, as given to readStart or setReportIds.
+ * Returns a non-empty string upon failure
+ */
+std::string parseReportIds(const Napi::Value &val, std::vector<unsigned char> &ids);
+
+/**
+ * Which report ids should be delivered to javascript. The read thread checks this before anything is allocated for a report.
+ * This can be changed from the main thread while reading
+ */
+class ReportIdFilter
+{
+public:
+    ReportIdFilter() { acceptAll(); }
+
+    void acceptAll()
+    {
+        for (auto &word : bits)
+        {
+            word.store(~0ull, std::memory_order_relaxed);
+        }
+    }
+
+    void acceptOnly(const std::vector<unsigned char> &ids)
+    {
+        uint64_t words[4] = {0, 0, 0, 0};
+        for (auto id : ids)
+        {
+            words[id >> 6] |= 1ull << (id & 63);
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            bits[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    bool accepts(unsigned char id) const
+    {
+        return (bits[id >> 6].load(std::memory_order_relaxed) >> (id & 63)) & 1;
+    }
+
+private:
+    std::atomic<uint64_t> bits[4];
+};
+
+/**
+ * Parse the options object given to readStart.
+ * Returns a non-empty string upon failure
+ */
+std::string parseReadOptions(const Napi::Value &val, ReadOptions &options);
+
+/**
+ * Get the report descriptor of a device.
+ * Returns a non-empty string upon failure
+ */
+std::string getReportDescriptor(hid_device *hid, std::vector<unsigned char> &descriptor);
+
+/**
+ * Reads input reports from a device, in a way that a waiting read can be cancelled from another thread.
+ * With the linux hidraw backend this sleeps on the device node alongside an eventfd, so it wakes as soon as a report arrives or it is interrupted.
+ * Elsewhere it falls back to calling hid_read_timeout in 50ms slices, checking for interruption between them.
+ */
+class InterruptibleReader
+{
+public:
+    // Every report read is counted in stats
+    InterruptibleReader(hid_device *hid, DeviceStats *stats);
+    ~InterruptibleReader();
+
+    /**
+     * Read a single report, waiting for up to milliseconds, or forever when -1.
+     * Returns the length read, 0 upon timeout or interruption, or -1 upon error, matching hid_read_timeout
+     */
+    int Read(unsigned char *buf, size_t length, int milliseconds);
+
+    // When the last report was read, on the monotonic clock in nanoseconds, and its sequence number from DeviceStats::countRead. Only valid once Read has returned a report
+    uint64_t ReceivedAt() const { return receivedAt; }
+    uint64_t Sequence() const { return sequence; }
+
+    // Wake any waiting Read, and make future calls return immediately until Reset. This may be called from any thread
+    void Interrupt();
+    void Reset();
+
+#ifdef NODE_HID_HIDRAW
+    // The descriptors to wait on for a report or an interrupt, or -1 when reads are polled through hidapi
+    int Fd() const { return fd; }
+    int WakeFd() const { return wakeFd; }
+#endif
+
+private:
+    int ReadReport(unsigned char *buf, size_t length, int milliseconds);
+
+    hid_device *hid;
+    DeviceStats *stats;
+    std::atomic<bool> interrupted = {false};
+
+    uint64_t receivedAt = 0;
+    uint64_t sequence = 0;
+
+#ifdef NODE_HID_HIDRAW
+    // Our own handle to the device node, only used to wait for reports as hidapi does not expose its own
+    int fd = -1;
+    int wakeFd = -1;
+#endif
+};
+
+/**
+ * Requests waiting for their reply, which the read thread looks for among the reports it reads, before any filtering.
+ * A report is the reply to a transaction when its bytes from offset equal the expected bytes. The oldest matching transaction takes it
+ */
+class TransactionTable
+{
+public:
+    // Begin waiting for a reply. Must be called from the main thread
+    void add(uint32_t id, size_t offset, std::vector<unsigned char> expected, Napi::Promise::Deferred deferred);
+
+    /**
+     * Find and remove the oldest transaction matching report. Called from the read thread.
+     * Returns its id, or 0 if nothing matches
+     */
+    uint32_t match(const unsigned char *report, size_t length);
+
+    // Complete a transaction with its reply. Must be called from the main thread
+    void resolve(uint32_t id, Napi::Value reply);
+    // Abandon a transaction, if it has not yet been completed. Must be called from the main thread
+    void reject(uint32_t id, const std::string &message);
+    // Abandon every transaction, once the read has stopped. Must be called from the main thread
+    void rejectAll(const std::string &message);
+
+private:
+    struct Pending
+    {
+        uint32_t id;
+        size_t offset;
+        std::vector<unsigned char> expected;
+    };
+
+    std::mutex lock;
+    std::vector<Pending> pending;
+    // So that the read thread can skip the lock when nothing is waiting
+    std::atomic<size_t> pendingCount = {0};
+
+    // Only accessed from the main thread. This outlives the entry in pending until the reply has been delivered
+    std::map<uint32_t, Napi::Promise::Deferred> promises;
+};
 
 struct ReadThreadState
 {
     std::atomic<bool> abort = {false};
 
+    // Which reports are passed on to javascript
+    ReportIdFilter reportFilter;
+
+    // Requests waiting for a reply from this read
+    TransactionTable transactions;
+
+    // Only accessed from the main thread. Set once reports are being read, so that a reply can't arrive before anything is looking for it
+    bool ready = false;
+    // Writes which are waiting for ready before being queued
+    std::vector<Napi::AsyncWorker *> afterReady;
+
     bool is_running();
     void wait();
 
+    // Ask the read thread to stop, waking it if it is waiting for a report
+    void stop();
+
     void release();
 
+    // Called by the read thread to make its reader available to stop()
+    void set_reader(InterruptibleReader *reader);
+
+    // Called when the read starts, so that stop() can wake it while it is waiting for space in its queue
+    void set_queue(std::mutex *queueLock, std::condition_variable *queueSpace);
+
 private:
     std::mutex lock;
     bool running = true;
     std::condition_variable wait_for_end;
+    InterruptibleReader *reader = nullptr;
+    std::mutex *queueLock = nullptr;
+    std::condition_variable *queueSpace = nullptr;
 };
 
+/**
+ * Set how many threads the shared read reactor uses. See ApplicationContext::setReadReactorThreads
+ */
+Napi::Value setReadReactorThreads(const Napi::CallbackInfo &info);
+
 std::shared_ptr<ReadThreadState>
-start_read_helper(Napi::Env env, std::shared_ptr<DeviceContext> hidHandle, Napi::Function callback);
+start_read_helper(Napi::Env env, std::shared_ptr<DeviceContext> hidHandle, Napi::Function callback, const ReadOptions &options);
 
 #endif // NODEHID_READ_H__
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "scheduler.h"
+
+#include <chrono>
+#include <cstring>
+
+OutputScheduler::OutputScheduler(std::shared_ptr<DeviceContext> context, const unsigned char *frames, size_t frameSize, size_t frameCount, uint64_t periodNs)
+    : context(std::move(context)), frames(frames), frameSize(frameSize), frameCount(frameCount), periodNs(periodNs)
+{
+    thread = std::thread(&OutputScheduler::Run, this);
+}
+
+OutputScheduler::~OutputScheduler()
+{
+    stop();
+    wait();
+}
+
+void OutputScheduler::stop()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    stopping = true;
+    wake.notify_all();
+}
+
+void OutputScheduler::wait()
+{
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void OutputScheduler::Run()
+{
+    // A copy of the frame being sent, so javascript updating it can't change it halfway through the write
+    std::vector<unsigned char> frame(frameSize);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t tick = 0;
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stopping)
+    {
+        guard.unlock();
+
+        std::memcpy(frame.data(), frames + (tick % frameCount) * frameSize, frameSize);
+        // A failure is counted in the statistics, and the next tick tries again
+        context->write(frame.data(), frame.size());
+
+        guard.lock();
+
+        // Skip any ticks which have already passed, rather than sending them late
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        uint64_t next = elapsed / periodNs + 1;
+        if (next > tick + 1)
+        {
+            context->stats.add(STAT_SCHEDULE_OVERRUNS, next - tick - 1);
+        }
+        tick = next;
+
+        wake.wait_until(guard, start + std::chrono::nanoseconds(tick * periodNs), [this]
+                        { return stopping; });
+    }
+}
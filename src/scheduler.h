@@ -0,0 +1,45 @@
+#ifndef NODEHID_SCHEDULER_H__
+#define NODEHID_SCHEDULER_H__
+
+#include "util.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes output reports at a fixed rate from a dedicated thread, for keep-alives and animations.
+ * Each tick is scheduled from the start time rather than the previous tick, so the timing doesn't drift, and ticks which can't be met are skipped instead of being sent late in a burst.
+ * The frames are read from memory shared with javascript, so they can be updated without calling into native code. Tick n sends frame n modulo the frame count
+ */
+class OutputScheduler
+{
+public:
+    /**
+     * Start writing. frames must stay alive until the scheduler has been stopped and waited for
+     */
+    OutputScheduler(std::shared_ptr<DeviceContext> context, const unsigned char *frames, size_t frameSize, size_t frameCount, uint64_t periodNs);
+    ~OutputScheduler();
+
+    // Ask the thread to stop, without waiting for it
+    void stop();
+    // Wait for the thread to exit. Must not be called from the scheduler thread
+    void wait();
+
+private:
+    void Run();
+
+    std::shared_ptr<DeviceContext> context;
+    const unsigned char *frames;
+    size_t frameSize;
+    size_t frameCount;
+    uint64_t periodNs;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+};
+
+#endif // NODEHID_SCHEDULER_H__
@@ -0,0 +1,259 @@
+#include "stats.h"
+#include "util.h"
+
+#include <algorithm>
+
+DeviceStats::DeviceStats()
+{
+    for (auto &counter : counters)
+    {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    callbackQueueDepth.store(0, std::memory_order_relaxed);
+    callbackQueueHighWater.store(0, std::memory_order_relaxed);
+
+    for (auto &histogram : histograms)
+    {
+        histogram.count.store(0, std::memory_order_relaxed);
+        histogram.totalNs.store(0, std::memory_order_relaxed);
+        histogram.maxNs.store(0, std::memory_order_relaxed);
+        for (auto &bucket : histogram.buckets)
+        {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+static void storeMax(std::atomic<uint64_t> &target, uint64_t value)
+{
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+void DeviceStats::record(StatHistogram histogram, uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+    int bucket = 0;
+    while (us != 0 && bucket < STAT_HISTOGRAM_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+
+    auto &target = histograms[histogram];
+    target.count.fetch_add(1, std::memory_order_relaxed);
+    target.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    target.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    storeMax(target.maxNs, ns);
+}
+
+uint64_t DeviceStats::countRead(int result)
+{
+    if (result > 0)
+    {
+        add(STAT_BYTES_READ, result);
+        return counters[STAT_REPORTS_READ].fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    else if (result < 0)
+    {
+        add(STAT_READ_ERRORS);
+    }
+    return 0;
+}
+
+void DeviceStats::countWrite(int result, uint64_t startedAt)
+{
+    record(STAT_WRITE_DURATION, monotonicNow() - startedAt);
+    if (result < 0)
+    {
+        add(STAT_WRITE_ERRORS);
+    }
+    else
+    {
+        add(STAT_REPORTS_WRITTEN);
+        add(STAT_BYTES_WRITTEN, result);
+    }
+}
+
+void DeviceStats::countFeature(int result, uint64_t startedAt)
+{
+    record(STAT_FEATURE_DURATION, monotonicNow() - startedAt);
+    add(result < 0 ? STAT_FEATURE_ERRORS : STAT_FEATURE_REPORTS);
+}
+
+void DeviceStats::callbackQueued()
+{
+    uint64_t depth = callbackQueueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+    storeMax(callbackQueueHighWater, depth);
+}
+
+void DeviceStats::callbackDone()
+{
+    callbackQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void DeviceStats::addTo(StatsSnapshot &snapshot) const
+{
+    for (int i = 0; i < STAT_COUNTER_COUNT; i++)
+    {
+        snapshot.counters[i] += counters[i].load(std::memory_order_relaxed);
+    }
+    snapshot.callbackQueueDepth += callbackQueueDepth.load(std::memory_order_relaxed);
+    snapshot.callbackQueueHighWater = std::max(snapshot.callbackQueueHighWater, callbackQueueHighWater.load(std::memory_order_relaxed));
+
+    for (int i = 0; i < STAT_HISTOGRAM_COUNT; i++)
+    {
+        auto &source = histograms[i];
+        auto &target = snapshot.histograms[i];
+
+        target.count += source.count.load(std::memory_order_relaxed);
+        target.totalNs += source.totalNs.load(std::memory_order_relaxed);
+        target.maxNs = std::max(target.maxNs, source.maxNs.load(std::memory_order_relaxed));
+        for (int j = 0; j < STAT_HISTOGRAM_BUCKETS; j++)
+        {
+            target.buckets[j] += source.buckets[j].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void StatsRegistry::add(DeviceStats *stats)
+{
+    std::unique_lock<std::mutex> lk(lock);
+    open.insert(stats);
+}
+
+void StatsRegistry::remove(DeviceStats *stats)
+{
+    std::unique_lock<std::mutex> lk(lock);
+    if (open.erase(stats))
+    {
+        stats->addTo(closed);
+        // Anything still queued for a closed device will never be counted as done
+        closed.callbackQueueDepth = 0;
+    }
+}
+
+StatsSnapshot StatsRegistry::snapshot(size_t &openDevices)
+{
+    std::unique_lock<std::mutex> lk(lock);
+
+    StatsSnapshot result = closed;
+    for (auto stats : open)
+    {
+        stats->addTo(result);
+    }
+    openDevices = open.size();
+
+    return result;
+}
+
+static const char *counterNames[STAT_COUNTER_COUNT] = {
+    "reportsRead",
+    "bytesRead",
+    "readErrors",
+    "reportsDropped",
+    "reportsFiltered",
+    "reportsUnchanged",
+    "reportsDecimated",
+    "messagesRead",
+    "framingErrors",
+    "reportsWritten",
+    "bytesWritten",
+    "writeErrors",
+    "writesCoalesced",
+    "scheduleOverruns",
+    "featureReports",
+    "featureErrors",
+    "featureReportsUnchanged",
+};
+
+static const char *histogramNames[STAT_HISTOGRAM_COUNT] = {
+    "queueWait",
+    "writeDuration",
+    "featureDuration",
+    "callbackLag",
+};
+
+/**
+ * Estimate a percentile of a histogram, as the upper bound of the bucket it falls in, in microseconds
+ */
+static double histogramPercentile(const StatsSnapshot::Histogram &histogram, double percentile)
+{
+    if (histogram.count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(histogram.count * percentile);
+    uint64_t seen = 0;
+    for (int i = 0; i < STAT_HISTOGRAM_BUCKETS - 1; i++)
+    {
+        seen += histogram.buckets[i];
+        if (seen > rank)
+        {
+            return std::min((double)(1ull << i), histogram.maxNs / 1000.0);
+        }
+    }
+    return histogram.maxNs / 1000.0;
+}
+
+static Napi::Object generateHistogram(const Napi::Env &env, const StatsSnapshot::Histogram &histogram)
+{
+    Napi::Object obj = Napi::Object::New(env);
+
+    obj.Set("count", Napi::Number::New(env, (double)histogram.count));
+    obj.Set("meanUs", Napi::Number::New(env, histogram.count ? histogram.totalNs / 1000.0 / histogram.count : 0));
+    obj.Set("p50Us", Napi::Number::New(env, histogramPercentile(histogram, 0.5)));
+    obj.Set("p90Us", Napi::Number::New(env, histogramPercentile(histogram, 0.9)));
+    obj.Set("p99Us", Napi::Number::New(env, histogramPercentile(histogram, 0.99)));
+    obj.Set("maxUs", Napi::Number::New(env, histogram.maxNs / 1000.0));
+
+    Napi::Array buckets = Napi::Array::New(env, STAT_HISTOGRAM_BUCKETS);
+    for (uint32_t i = 0; i < STAT_HISTOGRAM_BUCKETS; i++)
+    {
+        buckets.Set(i, Napi::Number::New(env, (double)histogram.buckets[i]));
+    }
+    obj.Set("buckets", buckets);
+
+    return obj;
+}
+
+Napi::Object generateStatsObject(const Napi::Env &env, const StatsSnapshot &stats)
+{
+    Napi::Object obj = Napi::Object::New(env);
+
+    for (int i = 0; i < STAT_COUNTER_COUNT; i++)
+    {
+        obj.Set(counterNames[i], Napi::Number::New(env, (double)stats.counters[i]));
+    }
+    obj.Set("callbackQueueDepth", Napi::Number::New(env, (double)stats.callbackQueueDepth));
+    obj.Set("callbackQueueHighWater", Napi::Number::New(env, (double)stats.callbackQueueHighWater));
+
+    for (int i = 0; i < STAT_HISTOGRAM_COUNT; i++)
+    {
+        obj.Set(histogramNames[i], generateHistogram(env, stats.histograms[i]));
+    }
+
+    return obj;
+}
+
+Napi::Value getGlobalStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    ContextState *context = (ContextState *)info.Data();
+    if (!context)
+    {
+        Napi::TypeError::New(env, "getStats missing context").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    size_t openDevices;
+    StatsSnapshot stats = context->appCtx->stats.snapshot(openDevices);
+
+    Napi::Object obj = generateStatsObject(env, stats);
+    obj.Set("openDevices", Napi::Number::New(env, (double)openDevices));
+    return obj;
+}
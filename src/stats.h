@@ -0,0 +1,153 @@
+#ifndef NODEHID_STATS_H__
+#define NODEHID_STATS_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <set>
+
+/**
+ * The current time of the monotonic clock, in nanoseconds
+ */
+inline uint64_t monotonicNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum StatCounter
+{
+    STAT_REPORTS_READ,
+    STAT_BYTES_READ,
+    STAT_READ_ERRORS,
+    // Reports read but discarded by the overflow policy of readStart
+    STAT_REPORTS_DROPPED,
+    // Reports read but discarded as nothing was subscribed to their report id
+    STAT_REPORTS_FILTERED,
+    // Reports read but discarded as they were the same as the previous one, with changesOnly
+    STAT_REPORTS_UNCHANGED,
+    // Reports read but replaced by a later one before they could be delivered, with maxRate
+    STAT_REPORTS_DECIMATED,
+    // Complete messages reassembled by the framer
+    STAT_MESSAGES_READ,
+    // Messages abandoned by the framer, as packets were missing or invalid
+    STAT_FRAMING_ERRORS,
+    STAT_REPORTS_WRITTEN,
+    STAT_BYTES_WRITTEN,
+    STAT_WRITE_ERRORS,
+    // Writes replaced by a newer one for the same key before they were sent, with writeLatest
+    STAT_WRITES_COALESCED,
+    // Ticks of an output schedule skipped because the previous write finished too late
+    STAT_SCHEDULE_OVERRUNS,
+    STAT_FEATURE_REPORTS,
+    STAT_FEATURE_ERRORS,
+    // Polls of a feature report which returned the same as before, so weren't passed to javascript
+    STAT_FEATURE_UNCHANGED,
+
+    STAT_COUNTER_COUNT
+};
+
+enum StatHistogram
+{
+    // From a job being queued for a device, until it starts executing
+    STAT_QUEUE_WAIT,
+    // Time spent inside hid_write
+    STAT_WRITE_DURATION,
+    // Time spent inside hid_get_feature_report or hid_send_feature_report
+    STAT_FEATURE_DURATION,
+    // From a report being handed to the event loop, until the javascript callback is run
+    STAT_CALLBACK_LAG,
+
+    STAT_HISTOGRAM_COUNT
+};
+
+// Bucket 0 counts durations under 1us, and bucket i those from 2^(i-1)us up to 2^i us. The last bucket also takes anything longer
+#define STAT_HISTOGRAM_BUCKETS 32
+
+/**
+ * A plain copy of some statistics, which can be summed across devices
+ */
+struct StatsSnapshot
+{
+    struct Histogram
+    {
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+        uint64_t buckets[STAT_HISTOGRAM_BUCKETS] = {};
+    };
+
+    uint64_t counters[STAT_COUNTER_COUNT] = {};
+    // Read callbacks waiting to be run by the event loop
+    uint64_t callbackQueueDepth = 0;
+    uint64_t callbackQueueHighWater = 0;
+    Histogram histograms[STAT_HISTOGRAM_COUNT];
+};
+
+/**
+ * Statistics for the io done on a single device.
+ * Everything is a relaxed atomic written by the thread doing the io, so recording costs little more than the increments, and nothing needs to be done to collect them until they are read
+ */
+class DeviceStats
+{
+public:
+    DeviceStats();
+
+    void add(StatCounter counter, uint64_t value = 1)
+    {
+        counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Add a duration in nanoseconds to a histogram
+    void record(StatHistogram histogram, uint64_t ns);
+
+    // Count the result of a read, matching the return value of hid_read. Returns the sequence number of the report read, which counts every report read from the device, or 0 if there was none
+    uint64_t countRead(int result);
+    // Count the result of a hid_write begun at startedAt
+    void countWrite(int result, uint64_t startedAt);
+    // Count the result of a feature report transfer begun at startedAt
+    void countFeature(int result, uint64_t startedAt);
+
+    // A read callback has been queued for the event loop
+    void callbackQueued();
+    // A read callback has been run, or discarded
+    void callbackDone();
+
+    // Add these statistics into snapshot
+    void addTo(StatsSnapshot &snapshot) const;
+
+private:
+    struct Histogram
+    {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> totalNs;
+        std::atomic<uint64_t> maxNs;
+        std::atomic<uint64_t> buckets[STAT_HISTOGRAM_BUCKETS];
+    };
+
+    std::atomic<uint64_t> counters[STAT_COUNTER_COUNT];
+    std::atomic<uint64_t> callbackQueueDepth;
+    std::atomic<uint64_t> callbackQueueHighWater;
+    Histogram histograms[STAT_HISTOGRAM_COUNT];
+};
+
+/**
+ * The statistics of every open device, so that totals can be produced for the whole process.
+ * The statistics of closed devices are folded into a running total, so that nothing is lost when they go away
+ */
+class StatsRegistry
+{
+public:
+    void add(DeviceStats *stats);
+    void remove(DeviceStats *stats);
+
+    // Sum the statistics of every device which has been opened. openDevices receives how many are still open
+    StatsSnapshot snapshot(size_t &openDevices);
+
+private:
+    std::mutex lock;
+    std::set<DeviceStats *> open;
+    StatsSnapshot closed;
+};
+
+#endif // NODEHID_STATS_H__
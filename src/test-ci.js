@@ -1,7 +1,218 @@
+const assert = require('assert');
+const { once } = require('events');
+
 console.log('test-ci: Attempting to load node-hid library');
 try {
     var HID = require('..');
 } catch(err){
     console.log('test-ci: This should error in CI: '+err);
 }
-console.log('test-ci: Done');
+
+// A gamepad with two signed axes and four buttons in report 1, followed by four bits of padding
+const GAMEPAD_DESCRIPTOR = [
+    0x05, 0x01, // Usage Page (Generic Desktop)
+    0x09, 0x05, // Usage (Game Pad)
+    0xa1, 0x01, // Collection (Application)
+    0x85, 0x01, //   Report ID (1)
+    0x09, 0x30, //   Usage (X)
+    0x09, 0x31, //   Usage (Y)
+    0x15, 0x81, //   Logical Minimum (-127)
+    0x25, 0x7f, //   Logical Maximum (127)
+    0x75, 0x08, //   Report Size (8)
+    0x95, 0x02, //   Report Count (2)
+    0x81, 0x02, //   Input (Data,Var,Abs)
+    0x05, 0x09, //   Usage Page (Button)
+    0x19, 0x01, //   Usage Minimum (1)
+    0x29, 0x04, //   Usage Maximum (4)
+    0x15, 0x00, //   Logical Minimum (0)
+    0x25, 0x01, //   Logical Maximum (1)
+    0x75, 0x01, //   Report Size (1)
+    0x95, 0x04, //   Report Count (4)
+    0x81, 0x02, //   Input (Data,Var,Abs)
+    0x95, 0x04, //   Report Count (4)
+    0x81, 0x03, //   Input (Const,Var,Abs)
+    0xc0, // End Collection
+];
+
+// A usage range which ends at the largest possible usage
+const HUGE_USAGE_RANGE_DESCRIPTOR = [
+    0x05, 0x09, // Usage Page (Button)
+    0xa1, 0x01, // Collection (Application)
+    0x19, 0x00, //   Usage Minimum (0)
+    0x2b, 0xff, 0xff, 0xff, 0xff, //   Usage Maximum (0xFFFFFFFF)
+    0x75, 0x01, //   Report Size (1)
+    0x95, 0x08, //   Report Count (8)
+    0x81, 0x02, //   Input (Data,Var,Abs)
+    0xc0, // End Collection
+];
+
+// Each packet is report 1, the channel, then the command or sequence number
+const FRAMER = { reportSize: 8, reportId: 1, channel: [0xaa] };
+
+function waitFor(emitter, eventName, timeout = 2000) {
+    let timer;
+    const timedOut = new Promise((resolve, reject) => {
+        timer = setTimeout(() => reject(new Error(`timed out waiting for "${eventName}"`)), timeout);
+    });
+    return Promise.race([once(emitter, eventName), timedOut]).finally(() => clearTimeout(timer));
+}
+
+async function withDevice(mock, options, test) {
+    const path = mock.addDevice(Object.assign({ vendorId: 0x1234, productId: 0x5678 }, options));
+    const device = await HID.HIDAsync.open(path);
+    try {
+        await test(device, path);
+    } finally {
+        await device.close();
+        mock.removeDevice(path);
+    }
+}
+
+const mockTests = {
+    async 'descriptor parsing'(mock) {
+        await withDevice(mock, { reportDescriptor: GAMEPAD_DESCRIPTOR }, async (device) => {
+            const fields = await device.getReportFields();
+            const inputs = fields.filter((field) => field.type === 'input');
+            assert.deepStrictEqual(inputs.map((field) => [field.usagePage, field.usage, field.bitOffset, field.bitSize]), [
+                [0x01, 0x30, 8, 8],
+                [0x01, 0x31, 16, 8],
+                [0x09, 1, 24, 1],
+                [0x09, 2, 25, 1],
+                [0x09, 3, 26, 1],
+                [0x09, 4, 27, 1],
+            ]);
+            assert.ok(inputs.every((field) => field.reportId === 1));
+            assert.strictEqual(inputs[0].logicalMinimum, -127);
+            assert.strictEqual(inputs[0].logicalMaximum, 127);
+        });
+
+        await withDevice(mock, { reportDescriptor: HUGE_USAGE_RANGE_DESCRIPTOR }, async (device) => {
+            await assert.rejects(device.getReportFields(), /too many usages/);
+        });
+    },
+
+    async 'report decoding'(mock) {
+        await withDevice(mock, { reportDescriptor: GAMEPAD_DESCRIPTOR }, async (device, path) => {
+            const decoded = waitFor(device, 'values');
+            mock.pushInputReport(path, [0x01, 0xfb, 100, 0x05]);
+
+            const [values, reportId] = await decoded;
+            assert.strictEqual(reportId, 1);
+            assert.deepStrictEqual(Array.from(values), [-5, 100, 1, 0, 1, 0]);
+        });
+    },
+
+    async 'framer round trip'(mock) {
+        await withDevice(mock, { loopback: true }, async (device) => {
+            device.setFramer(FRAMER);
+            const received = waitFor(device, 'message');
+
+            // Longer than one packet, so that it needs a continuation
+            const payload = Buffer.from([1, 2, 3, 4, 5, 6, 7, 8, 9, 10]);
+            const written = await device.sendMessage(0x10, payload);
+            assert.strictEqual(written.length, 2);
+
+            const [command, message] = await received;
+            assert.strictEqual(command, 0x10);
+            assert.deepStrictEqual(Buffer.from(message), payload);
+            assert.strictEqual(device.getStats().framingErrors, 0);
+
+            await assert.rejects(device.sendMessage(0x80, payload), /from 0 to 127/);
+        });
+    },
+
+    async 'framer sequence errors'(mock) {
+        await withDevice(mock, {}, async (device, path) => {
+            device.setFramer(FRAMER);
+            const messages = [];
+            device.on('message', (command, message) => messages.push([command, Array.from(message)]));
+
+            // A ten byte message whose continuation has the wrong sequence number
+            mock.pushInputReport(path, [0x01, 0xaa, 0x91, 0x00, 0x0a, 1, 2, 3, 4]);
+            mock.pushInputReport(path, [0x01, 0xaa, 0x05, 5, 6, 7, 8, 9, 10]);
+
+            // Then a complete single packet message, which should still get through
+            const received = waitFor(device, 'message');
+            mock.pushInputReport(path, [0x01, 0xaa, 0x92, 0x00, 0x02, 7, 8, 0]);
+            await received;
+
+            assert.deepStrictEqual(messages, [[0x12, [7, 8]]]);
+            assert.strictEqual(device.getStats().framingErrors, 1);
+        });
+    },
+
+    async 'writeLatest coalescing'(mock) {
+        // Slow writes, so that the later calls arrive while earlier ones are waiting
+        await withDevice(mock, { writeLatencyUs: 20000 }, async (device, path) => {
+            const results = await Promise.all([
+                device.writeLatest([0x01, 1]),
+                device.writeLatest([0x01, 2]),
+                device.writeLatest([0x01, 3]),
+                device.writeLatest([0x02, 1]),
+            ]);
+
+            // The newest of each key is always written
+            assert.strictEqual(results[2], 2);
+            assert.strictEqual(results[3], 2);
+
+            const coalesced = results.filter((result) => result === 'coalesced').length;
+            assert.ok(coalesced >= 1, 'expected a write to be coalesced');
+            assert.strictEqual(device.getStats().writesCoalesced, coalesced);
+            assert.strictEqual(mock.getStats(path).writes, results.length - coalesced);
+        });
+    },
+
+    async 'transact matching'(mock) {
+        await withDevice(mock, { loopback: true }, async (device) => {
+            // Each request is echoed back, so is its own reply
+            const replies = await Promise.all([
+                device.transact([0x02, 0x11]),
+                device.transact([0x03, 0x22]),
+                device.transact([0x04, 0x33, 0x44], { match: { offset: 1, bytes: [0x33] } }),
+            ]);
+            assert.deepStrictEqual(replies.map((reply) => Array.from(reply)), [
+                [0x02, 0x11],
+                [0x03, 0x22],
+                [0x04, 0x33, 0x44],
+            ]);
+        });
+    },
+
+    async 'transact timeout'(mock) {
+        await withDevice(mock, {}, async (device) => {
+            await assert.rejects(device.transact([0x02, 0x11], { timeout: 50 }), /timed out/);
+        });
+    },
+};
+
+// These need the mock driver, built with `node-gyp rebuild --driver=mock`
+function getMockControl() {
+    if (!HID)
+        return null;
+    try {
+        HID.setDriverType('mock');
+        return HID.getMockControl();
+    } catch (err) {
+        console.log('test-ci: Skipping the mock tests: ' + err.message);
+        return null;
+    }
+}
+
+async function runMockTests() {
+    const mock = getMockControl();
+    if (!mock)
+        return;
+
+    for (const name of Object.keys(mockTests)) {
+        console.log('test-ci: ' + name);
+        mock.reset();
+        await mockTests[name](mock);
+    }
+}
+
+runMockTests().then(() => {
+    console.log('test-ci: Done');
+}, (err) => {
+    console.log('test-ci: Failed: ' + (err.stack || err));
+    process.exitCode = 1;
+});
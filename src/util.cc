@@ -1,8 +1,16 @@
 #include <sstream>
 #include <locale>
 #include <codecvt>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
 #include "util.h"
+#include "hotplug.h"
+
+#ifdef NODE_HID_HIDRAW
+#include "reactor.h"
+#endif
 
 // Ensure hid_init/hid_exit is coordinated across all threads. Global data is bad for context-aware modules, but this is designed to be safe
 std::mutex lockApplicationContext;
@@ -10,6 +18,10 @@ std::weak_ptr<ApplicationContext> weakApplicationContext; // This will let it be
 
 ApplicationContext::~ApplicationContext()
 {
+    // Stop the reactor and hotplug threads before hidapi goes away
+    reactor = nullptr;
+    hotplug = nullptr;
+
     // Make sure we dont try to aquire it or run init at the same time
     std::unique_lock<std::mutex> lock(lockApplicationContext);
 
@@ -40,6 +52,58 @@ std::shared_ptr<ApplicationContext> ApplicationContext::get()
     return ref;
 }
 
+std::shared_ptr<ReadReactor> ApplicationContext::getReadReactor()
+{
+    std::unique_lock<std::mutex> lock(reactorLock);
+    if (reactorThreads == 0)
+    {
+        return nullptr;
+    }
+
+#ifdef NODE_HID_HIDRAW
+    if (!reactor)
+    {
+        reactor = std::make_shared<ReadReactor>(reactorThreads);
+    }
+#endif
+
+    return reactor;
+}
+
+HotplugMonitor *ApplicationContext::getHotplugMonitor()
+{
+    std::unique_lock<std::mutex> lock(hotplugLock);
+
+#ifdef NODE_HID_HIDRAW
+    if (!hotplug)
+    {
+        hotplug = std::unique_ptr<HotplugMonitor>(new HotplugMonitor(enumerationCache, enumerateLock));
+    }
+#endif
+
+    return hotplug.get();
+}
+
+std::string ApplicationContext::setReadReactorThreads(int threads)
+{
+    if (threads < 0 || threads > READ_REACTOR_MAX_THREADS)
+    {
+        return "the read reactor can use at most " + std::to_string(READ_REACTOR_MAX_THREADS) + " threads";
+    }
+
+    std::unique_lock<std::mutex> lock(reactorLock);
+
+#ifdef NODE_HID_HIDRAW
+    if (reactor && threads != 0 && threads != reactor->ThreadCount())
+    {
+        return "the read reactor is already running with a different number of threads";
+    }
+#endif
+
+    reactorThreads = threads;
+    return "";
+}
+
 std::string utf8_encode(const std::wstring &source)
 {
     return std::wstring_convert<std::codecvt_utf8<wchar_t>>().to_bytes(source);
@@ -85,8 +149,181 @@ std::string copyArrayOrBufferIntoVector(const Napi::Value &val, std::vector<unsi
     }
 }
 
+std::string getTargetBuffer(const Napi::Value &val, unsigned char *&data, size_t &length)
+{
+    if (!val.IsTypedArray() || val.As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array)
+    {
+        return "expecting a Buffer or Uint8Array to read into";
+    }
+
+    Napi::Uint8Array array = val.As<Napi::Uint8Array>();
+    data = array.Data();
+    length = array.ElementLength();
+    if (length == 0)
+    {
+        return "buffer to read into cannot be empty";
+    }
+
+    return "";
+}
+
+std::string WriteData::assign(const Napi::Value &val)
+{
+    if (val.IsBuffer())
+    {
+        Napi::Buffer<unsigned char> buffer = val.As<Napi::Buffer<unsigned char>>();
+        pinned = Napi::Persistent(buffer.As<Napi::Object>());
+        _data = buffer.Data();
+        _size = buffer.Length();
+
+        return "";
+    }
+
+    std::string copyError = copyArrayOrBufferIntoVector(val, copied);
+    _data = copied.data();
+    _size = copied.size();
+
+    return copyError;
+}
+
+std::string copyReportsIntoVector(const Napi::CallbackInfo &info, std::vector<unsigned char> &data, std::vector<size_t> &offsets)
+{
+    if (info.Length() == 2)
+    {
+        if (!info[0].IsBuffer() || !info[1].IsNumber())
+        {
+            return "writeMany expects a buffer and a stride";
+        }
+
+        Napi::Buffer<unsigned char> buffer = info[0].As<Napi::Buffer<unsigned char>>();
+        int64_t stride = info[1].As<Napi::Number>().Int64Value();
+        if (stride <= 0 || buffer.Length() % stride != 0)
+        {
+            return "writeMany buffer length must be a multiple of stride";
+        }
+
+        data.assign(buffer.Data(), buffer.Data() + buffer.Length());
+
+        offsets.reserve(buffer.Length() / stride + 1);
+        for (size_t offset = 0; offset <= buffer.Length(); offset += stride)
+        {
+            offsets.push_back(offset);
+        }
+
+        return "";
+    }
+    else if (info.Length() == 1 && info[0].IsArray())
+    {
+        Napi::Array reports = info[0].As<Napi::Array>();
+        offsets.reserve(reports.Length() + 1);
+
+        for (unsigned i = 0; i < reports.Length(); i++)
+        {
+            offsets.push_back(data.size());
+
+            Napi::Value report = reports.Get(i);
+            if (report.IsBuffer())
+            {
+                Napi::Buffer<unsigned char> buffer = report.As<Napi::Buffer<unsigned char>>();
+                data.insert(data.end(), buffer.Data(), buffer.Data() + buffer.Length());
+            }
+            else if (report.IsArray())
+            {
+                Napi::Array bytes = report.As<Napi::Array>();
+                for (unsigned j = 0; j < bytes.Length(); j++)
+                {
+                    Napi::Value v = bytes.Get(j);
+                    if (!v.IsNumber())
+                    {
+                        return "unexpected array element in array to send, expecting only integers";
+                    }
+                    data.push_back((unsigned char)v.As<Napi::Number>().Uint32Value());
+                }
+            }
+            else
+            {
+                return "unexpected report to send, expecting an array or buffer";
+            }
+        }
+        offsets.push_back(data.size());
+
+        return "";
+    }
+    else
+    {
+        return "writeMany expects an array of reports, or a buffer and a stride";
+    }
+}
+
+LatestReports::~LatestReports()
+{
+    for (auto &entry : entries)
+    {
+        delete entry.load(std::memory_order_relaxed);
+    }
+}
+
+void LatestReports::store(unsigned char reportId, const unsigned char *report, size_t length, uint64_t receivedAt, uint64_t sequence)
+{
+    Entry *entry = entries[reportId].load(std::memory_order_relaxed);
+    if (!entry)
+    {
+        entry = new Entry;
+        entries[reportId].store(entry, std::memory_order_release);
+    }
+
+    length = std::min<size_t>(length, READ_BUFF_MAXSIZE);
+
+    // An odd version marks the entry as being written
+    uint32_t version = entry->version.load(std::memory_order_relaxed);
+    entry->version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(entry->data, report, length);
+    entry->length = length;
+    entry->receivedAt = receivedAt;
+    entry->sequence = sequence;
+
+    entry->version.store(version + 2, std::memory_order_release);
+}
+
+size_t LatestReports::load(unsigned char reportId, unsigned char *target, size_t targetLength, uint64_t &receivedAt, uint64_t &sequence) const
+{
+    const Entry *entry = entries[reportId].load(std::memory_order_acquire);
+    if (!entry)
+    {
+        return 0;
+    }
+
+    while (true)
+    {
+        uint32_t version = entry->version.load(std::memory_order_acquire);
+        if (version & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        size_t length = entry->length;
+        memcpy(target, entry->data, std::min(length, targetLength));
+        receivedAt = entry->receivedAt;
+        sequence = entry->sequence;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry->version.load(std::memory_order_relaxed) == version)
+        {
+            return length;
+        }
+    }
+}
+
 DeviceContext::~DeviceContext()
 {
+    // The lane must be finished with the handle before it is closed
+    Shutdown();
+
+    appCtx->stats.remove(&stats);
+
     if (hid)
     {
         // We shouldn't ever get here, but lets make sure it was freed
@@ -95,6 +332,33 @@ DeviceContext::~DeviceContext()
     }
 }
 
+int DeviceContext::write(const unsigned char *data, size_t length)
+{
+    std::unique_lock<std::mutex> lock(writeLock);
+
+    uint64_t startedAt = monotonicNow();
+    int written = hid_write(hid, data, length);
+    stats.countWrite(written, startedAt);
+    return written;
+}
+
+void DeviceContext::writeMany(const unsigned char *data, const std::vector<size_t> &offsets, std::vector<int> &written)
+{
+    std::unique_lock<std::mutex> lock(writeLock);
+
+    for (size_t i = 0; i + 1 < offsets.size(); i++)
+    {
+        uint64_t startedAt = monotonicNow();
+        int res = hid_write(hid, data + offsets[i], offsets[i + 1] - offsets[i]);
+        stats.countWrite(res, startedAt);
+        written.push_back(res);
+        if (res < 0)
+        {
+            return;
+        }
+    }
+}
+
 void AsyncWorkerQueue::QueueJob(const Napi::Env &, Napi::AsyncWorker *job)
 {
     std::unique_lock<std::mutex> lock(jobQueueMutex);
@@ -124,3 +388,312 @@ void AsyncWorkerQueue::JobFinished(const Napi::Env &)
         newJob->Queue();
     }
 }
+
+// How long the io lane thread of a device waits for more work before exiting
+#define IO_LANE_IDLE_TIMEOUT_MS 1000
+
+/**
+ * Jobs which have been executed by a lane, waiting to be completed on the main thread.
+ * This is owned by the tsfn rather than the lane, as a call may still be queued after the lane has been destroyed.
+ */
+struct DeviceIoLaneCompletions
+{
+    std::mutex lock;
+    std::vector<Napi::AsyncWorker *> jobs;
+    std::atomic<bool> notifyPending = {false};
+
+    Napi::TypedThreadSafeFunction<DeviceIoLaneCompletions, void, nullptr> tsfn;
+};
+
+static void CompleteLaneJobs(Napi::Env env, Napi::Function, DeviceIoLaneCompletions *completions, void *)
+{
+    if (env == nullptr)
+    {
+        return;
+    }
+
+    // Clear this first, so that any job finishing from here on will schedule another call
+    completions->notifyPending = false;
+
+    std::vector<Napi::AsyncWorker *> jobs;
+    {
+        std::unique_lock<std::mutex> lk(completions->lock);
+        jobs.swap(completions->jobs);
+    }
+
+    for (auto job : jobs)
+    {
+        // This resolves the promise and frees the job. The last job may free the lane too
+        job->OnWorkComplete(env, napi_ok);
+    }
+}
+
+using DeviceIoLaneTSFN = Napi::TypedThreadSafeFunction<DeviceIoLaneCompletions, void, CompleteLaneJobs>;
+
+DeviceIoLane::~DeviceIoLane()
+{
+    Shutdown();
+
+    if (completions)
+    {
+        DeviceIoLaneTSFN(completions->tsfn).Release();
+    }
+}
+
+void DeviceIoLane::Shutdown()
+{
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        stopping = true;
+        wake.notify_all();
+    }
+
+    if (thread.joinable())
+    {
+        assert(thread.get_id() != std::this_thread::get_id());
+        thread.join();
+    }
+}
+
+void DeviceIoLane::QueueJob(const Napi::Env &env, Napi::AsyncWorker *job)
+{
+    if (!completions)
+    {
+        this->env = env;
+
+        completions = new DeviceIoLaneCompletions;
+
+        // The function is required with node-api 4, but is never called
+        auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo &) {});
+        auto tsfn = DeviceIoLaneTSFN::New(
+            env,
+            noop,
+            "HID:io",
+            0,
+            1,
+            completions,
+            [](Napi::Env, void *, DeviceIoLaneCompletions *completions)
+            {
+                delete completions;
+            });
+        // Only keep the event loop alive while there are jobs in flight
+        tsfn.Unref(env);
+        completions->tsfn = napi_threadsafe_function(tsfn);
+    }
+
+    if (inflight++ == 0)
+    {
+        DeviceIoLaneTSFN(completions->tsfn).Ref(env);
+    }
+
+    LaneJob entry = {job, monotonicNow()};
+
+    // Preserve the ordering, if anything is already waiting for space
+    if (!backlog.empty() || !ring.push(entry))
+    {
+        backlog.push(entry);
+        return;
+    }
+
+    Wake();
+}
+
+void DeviceIoLane::Wake()
+{
+    if (sleeping || !running)
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        if (stopping)
+        {
+            // Shut down, so there is nothing to run the job
+            return;
+        }
+        if (!running)
+        {
+            // The previous thread has exited, or is about to
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+
+            running = true;
+            thread = std::thread(&DeviceIoLane::Run, this);
+        }
+        else
+        {
+            wake.notify_one();
+        }
+    }
+}
+
+void DeviceIoLane::FlushBacklog()
+{
+    while (!backlog.empty() && ring.push(backlog.front()))
+    {
+        backlog.pop();
+    }
+
+    Wake();
+}
+
+void DeviceIoLane::JobFinished(const Napi::Env &env)
+{
+    if (!backlog.empty())
+    {
+        FlushBacklog();
+    }
+
+    if (--inflight == 0)
+    {
+        DeviceIoLaneTSFN(completions->tsfn).Unref(env);
+    }
+}
+
+void DeviceIoLane::AddTask(std::shared_ptr<LaneTask> task)
+{
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        task->nextDue = monotonicNow();
+        tasks.push_back(std::move(task));
+        tasksChanged = true;
+    }
+
+    Wake();
+}
+
+void DeviceIoLane::RemoveTask(const std::shared_ptr<LaneTask> &task)
+{
+    std::unique_lock<std::mutex> lk(lock);
+    tasks.erase(std::remove(tasks.begin(), tasks.end(), task), tasks.end());
+
+    if (thread.get_id() != std::this_thread::get_id())
+    {
+        taskDone.wait(lk, [this, &task]
+                      { return runningTask != task.get(); });
+    }
+}
+
+uint64_t DeviceIoLane::RunTasks()
+{
+    std::vector<std::shared_ptr<LaneTask>> due;
+    uint64_t nextDue = 0;
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        uint64_t now = monotonicNow();
+        for (auto &task : tasks)
+        {
+            if (task->nextDue <= now)
+            {
+                due.push_back(task);
+                // Skip any runs which have been missed, rather than catching up in a burst
+                task->nextDue += ((now - task->nextDue) / task->intervalNs + 1) * task->intervalNs;
+            }
+            if (nextDue == 0 || task->nextDue < nextDue)
+            {
+                nextDue = task->nextDue;
+            }
+        }
+    }
+
+    for (auto &task : due)
+    {
+        {
+            std::unique_lock<std::mutex> lk(lock);
+            // It may have been removed since it was found to be due
+            if (std::find(tasks.begin(), tasks.end(), task) == tasks.end())
+            {
+                continue;
+            }
+            runningTask = task.get();
+        }
+
+        bool keep = task->Run();
+
+        {
+            std::unique_lock<std::mutex> lk(lock);
+            runningTask = nullptr;
+            if (!keep)
+            {
+                tasks.erase(std::remove(tasks.begin(), tasks.end(), task), tasks.end());
+            }
+        }
+        taskDone.notify_all();
+    }
+
+    return nextDue;
+}
+
+void DeviceIoLane::Run()
+{
+    while (true)
+    {
+        // Tasks are checked between jobs, so a busy lane can't starve them
+        uint64_t nextDue = RunTasks();
+
+        LaneJob entry;
+        if (ring.pop(entry))
+        {
+            auto job = entry.job;
+            stats.record(STAT_QUEUE_WAIT, monotonicNow() - entry.queuedAt);
+
+            // Executes the job, capturing any error for OnWorkComplete
+            job->OnExecute(env);
+
+            {
+                std::unique_lock<std::mutex> lk(completions->lock);
+                completions->jobs.push_back(job);
+            }
+            if (!completions->notifyPending.exchange(true))
+            {
+                DeviceIoLaneTSFN(completions->tsfn).NonBlockingCall();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(lock);
+
+        // This must be set before checking the ring, so that QueueJob will see it if we miss a job
+        sleeping = true;
+        if (!ring.empty() || stopping || tasksChanged)
+        {
+            sleeping = false;
+            tasksChanged = false;
+            if (stopping)
+                return;
+            continue;
+        }
+
+        if (nextDue != 0)
+        {
+            // Wait for a job, or the next task to be due. The thread never exits while it has tasks
+            auto due = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(nextDue)));
+            wake.wait_until(lk, due, [this]
+                            { return !ring.empty() || stopping || tasksChanged; });
+
+            sleeping = false;
+            tasksChanged = false;
+            if (stopping)
+            {
+                return;
+            }
+            continue;
+        }
+
+        bool woken = wake.wait_for(lk, std::chrono::milliseconds(IO_LANE_IDLE_TIMEOUT_MS), [this]
+                                   { return !ring.empty() || stopping || tasksChanged; });
+        if (!woken && !stopping)
+        {
+            // Idle for too long. Wake will start a new thread when needed.
+            // This must be cleared before sleeping, so that a job queued in between sees one or the other
+            running = false;
+            sleeping = false;
+            return;
+        }
+
+        sleeping = false;
+        if (stopping)
+        {
+            return;
+        }
+    }
+}
@@ -4,11 +4,21 @@
 #define NAPI_VERSION 4
 #include <napi.h>
 
+#include <map>
 #include <queue>
+#include <tuple>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 #include <hidapi.h>
 
+#include "enumeration.h"
+#include "stats.h"
+
 #define READ_BUFF_MAXSIZE 2048
+// Each reactor thread can watch many devices, so there is no need for more than this
+#define READ_REACTOR_MAX_THREADS 64
 
 std::string utf8_encode(const std::wstring &source);
 std::wstring utf8_decode(const std::string &source);
@@ -19,6 +29,58 @@ std::wstring utf8_decode(const std::string &source);
  */
 std::string copyArrayOrBufferIntoVector(const Napi::Value &val, std::vector<unsigned char> &message);
 
+/**
+ * Get the memory of a js value (a Buffer or Uint8Array), to read into.
+ * Returns a non-empty string upon failure
+ */
+std::string getTargetBuffer(const Napi::Value &val, unsigned char *&data, size_t &length);
+
+/**
+ * The data of a report to be written by a worker.
+ * A buffer is referenced rather than copied, so must not be modified until the operation has completed. An array of numbers is copied.
+ * Note: This must be created and destroyed on the main thread
+ */
+class WriteData
+{
+public:
+    /**
+     * Take the data from a js value (either a buffer or array of numbers).
+     * Returns a non-empty string upon failure
+     */
+    std::string assign(const Napi::Value &val);
+
+    const unsigned char *data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    Napi::ObjectReference pinned;
+    std::vector<unsigned char> copied;
+
+    const unsigned char *_data = nullptr;
+    size_t _size = 0;
+};
+
+/**
+ * Convert the arguments of writeMany (either an array of buffers or arrays of numbers, or a buffer and a stride) into a single vector of bytes.
+ * `offsets` receives the start of each report, followed by the total length.
+ * Returns a non-empty string upon failure
+ */
+std::string copyReportsIntoVector(const Napi::CallbackInfo &info, std::vector<unsigned char> &data, std::vector<size_t> &offsets);
+
+/**
+ * Convert some statistics into the object returned by getStats
+ */
+Napi::Object generateStatsObject(const Napi::Env &env, const StatsSnapshot &stats);
+
+/**
+ * Get the statistics summed across every device opened by this process
+ */
+Napi::Value getGlobalStats(const Napi::CallbackInfo &info);
+
+class ReadReactor;
+class HotplugMonitor;
+class LatestWriteWorker;
+
 /**
  * Application-wide shared state.
  * This is referenced by the main thread and every worker_thread where node-hid has been loaded and not yet unloaded.
@@ -33,6 +95,38 @@ public:
     // A lock for any enumerate/open operations, as they are not thread safe
     // In async land, these are also done in a single-threaded queue, this lock is used to link up with the sync side
     std::mutex enumerateLock;
+
+    // Results of hid_enumerate, when enabled
+    EnumerationCache enumerationCache;
+
+    // The statistics of every device, for the process-wide totals
+    StatsRegistry stats;
+
+    /**
+     * Get the reactor which should be used for new reads, starting it if needed.
+     * Returns nullptr when the reactor is disabled or not supported by this backend
+     */
+    std::shared_ptr<ReadReactor> getReadReactor();
+
+    /**
+     * Set how many threads the reactor should use, with 0 disabling it for new reads, up to READ_REACTOR_MAX_THREADS.
+     * Returns a non-empty string upon failure
+     */
+    std::string setReadReactorThreads(int threads);
+
+    /**
+     * Get the monitor for devices being added and removed.
+     * Returns nullptr when not supported by this backend
+     */
+    HotplugMonitor *getHotplugMonitor();
+
+private:
+    std::mutex reactorLock;
+    int reactorThreads = 0;
+    std::shared_ptr<ReadReactor> reactor;
+
+    std::mutex hotplugLock;
+    std::unique_ptr<HotplugMonitor> hotplug;
 };
 
 class AsyncWorkerQueue
@@ -74,13 +168,194 @@ public:
 
     // Constructor for the HIDAsync class
     Napi::FunctionReference asyncCtor;
+
+    // The objects returned for cached devices, by path and usage, so that they can be reused while the device is unchanged
+    std::map<std::tuple<std::string, unsigned short, unsigned short>, std::pair<std::shared_ptr<const CachedDevice>, Napi::ObjectReference>> deviceObjects;
+};
+
+/**
+ * A fixed size single-producer single-consumer queue, which needs no locking
+ */
+template <typename T, size_t Capacity>
+class SpscRing
+{
+public:
+    // Add an item to the queue. Must only be called by the producer. Returns false if full
+    bool push(T value)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        items[head % Capacity] = value;
+        _head.store(head + 1);
+        return true;
+    }
+
+    // Take an item from the queue. Must only be called by the consumer. Returns false if empty
+    bool pop(T &value)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load())
+        {
+            return false;
+        }
+        value = items[tail % Capacity];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _tail.load() == _head.load();
+    }
+
+private:
+    std::atomic<size_t> _head = {0};
+    std::atomic<size_t> _tail = {0};
+    T items[Capacity];
 };
 
-class DeviceContext : public AsyncWorkerQueue
+struct DeviceIoLaneCompletions;
+
+/**
+ * Work which a DeviceIoLane repeats at a fixed interval between its jobs, such as polling a feature report.
+ * It runs on the lane thread, so never overlaps a job for the same device
+ */
+class LaneTask
 {
 public:
-    DeviceContext(std::shared_ptr<ApplicationContext> appCtx, hid_device *hidHandle) : AsyncWorkerQueue(), hid(hidHandle), appCtx(appCtx)
+    LaneTask(uint64_t intervalNs) : intervalNs(intervalNs) {}
+    virtual ~LaneTask() = default;
+
+    // Called on the lane thread each time the task is due. Returns false once it should be removed
+    virtual bool Run() = 0;
+
+private:
+    friend class DeviceIoLane;
+
+    uint64_t intervalNs;
+    // When the task should next run, on the clock of monotonicNow. Guarded by the lock of the lane
+    uint64_t nextDue = 0;
+};
+
+/**
+ * A dedicated thread to run the jobs for a single device, in the order they were queued.
+ * This keeps device io off the libuv threadpool, where a slow device would hold up unrelated work, and avoids a threadpool round trip for each job.
+ * Jobs are handed over through a lock-free ring, and any which finish together are completed with a single call back into the event loop.
+ * The thread is started on demand, and exits again once it has been idle for a while, so that idle devices cost nothing.
+ */
+class DeviceIoLane
+{
+public:
+    ~DeviceIoLane();
+
+    /**
+     * Stop the lane thread, waiting for any job or task it is running to return.
+     * Note: This must not be run from the lane thread. The lane never holds a reference to its own DeviceContext, so it can't be the one to free it
+     */
+    void Shutdown();
+
+    /**
+     * Push a job onto the lane.
+     * Note: This must only be run from the main thread
+     */
+    void QueueJob(const Napi::Env &, Napi::AsyncWorker *job);
+
+    /**
+     * The job has finished.
+     * Note: This must only be run from the main thread
+     */
+    void JobFinished(const Napi::Env &);
+
+    /**
+     * Run a task at its interval until it is removed, starting straight away.
+     * The lane thread keeps running while it has any tasks
+     */
+    void AddTask(std::shared_ptr<LaneTask> task);
+    // Waits for the task to return if it is running, so that the caller can then free anything it uses
+    void RemoveTask(const std::shared_ptr<LaneTask> &task);
+
+    // Statistics for the io done on this device, whether by the lane or elsewhere
+    DeviceStats stats;
+
+private:
+    struct LaneJob
+    {
+        Napi::AsyncWorker *job;
+        // When the job was queued, for the queue wait statistics
+        uint64_t queuedAt;
+    };
+
+    void Run();
+    void Wake();
+    void FlushBacklog();
+    // Run any tasks which are due, returning when the next one is, or 0 if there are none
+    uint64_t RunTasks();
+
+    SpscRing<LaneJob, 256> ring;
+    // Jobs which didn't fit in the ring. Only accessed from the main thread
+    std::queue<LaneJob> backlog;
+
+    // Only accessed from the main thread
+    napi_env env = nullptr;
+    size_t inflight = 0;
+    DeviceIoLaneCompletions *completions = nullptr;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::thread thread;
+    std::atomic<bool> running = {false};
+    std::atomic<bool> sleeping = {false};
+    bool stopping = false;
+
+    // Guarded by lock. tasksChanged wakes the thread to reconsider when it should next run
+    std::vector<std::shared_ptr<LaneTask>> tasks;
+    bool tasksChanged = false;
+    // The task which the lane is running, signalled by taskDone once it returns
+    LaneTask *runningTask = nullptr;
+    std::condition_variable taskDone;
+};
+
+/**
+ * The most recent input report of each report id, which can be copied out from any thread without waiting for the reader.
+ * Each report is guarded by a seqlock, so the read thread never blocks, and a reader retries if the report changed while it was copying
+ */
+class LatestReports
+{
+public:
+    ~LatestReports();
+
+    // Replace the report for reportId. Must only be called by the read thread
+    void store(unsigned char reportId, const unsigned char *report, size_t length, uint64_t receivedAt, uint64_t sequence);
+
+    /**
+     * Copy the latest report with reportId into target, which is truncated to targetLength.
+     * Returns the full length of the report, or 0 if none has been received
+     */
+    size_t load(unsigned char reportId, unsigned char *target, size_t targetLength, uint64_t &receivedAt, uint64_t &sequence) const;
+
+private:
+    struct Entry
     {
+        std::atomic<uint32_t> version = {0};
+        uint64_t receivedAt = 0;
+        uint64_t sequence = 0;
+        size_t length = 0;
+        unsigned char data[READ_BUFF_MAXSIZE];
+    };
+
+    // Created by the read thread the first time each report id is seen, and kept until the device is freed
+    std::atomic<Entry *> entries[256] = {};
+};
+
+class DeviceContext : public DeviceIoLane
+{
+public:
+    DeviceContext(std::shared_ptr<ApplicationContext> appCtx, hid_device *hidHandle) : DeviceIoLane(), hid(hidHandle), appCtx(appCtx)
+    {
+        appCtx->stats.add(&stats);
     }
 
     ~DeviceContext();
@@ -89,7 +364,28 @@ public:
 
     bool is_closed = false;
 
+    /**
+     * Write a report with hid_write, counting it in the statistics.
+     * Writes are serialised, as an OutputScheduler may write alongside the jobs of the lane
+     */
+    int write(const unsigned char *data, size_t length);
+
+    /**
+     * Write the reports starting at each of offsets, which ends with the total length, without any other write coming between them.
+     * written receives the result of each, stopping at the first failure
+     */
+    void writeMany(const unsigned char *data, const std::vector<size_t> &offsets, std::vector<int> &written);
+
+    // Kept up to date by reads started with the latest option
+    LatestReports latest;
+
+    // Writes from writeLatest which haven't been started by the lane, by key, so that a newer payload can replace them
+    std::mutex coalesceLock;
+    std::map<uint32_t, LatestWriteWorker *> coalescing;
+
 private:
+    std::mutex writeLock;
+
     // Hold a reference to the ApplicationContext,
     std::shared_ptr<ApplicationContext> appCtx;
 };